@@ -2,10 +2,13 @@
 #include "../core/rasterizer.h"
 #include "../core/scanline/scanline_rasterizer.h"
 #include "../core/vg/rvg.h"
+#include "../core/vg/bvg.h"
+#include "../core/vg/vg_simplify.h"
 #include "../core/common/camera.hpp"
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <chrono>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -30,6 +33,8 @@ public:
 	VGApplication* appName(const char* name) override;
 
 	VGApplication* loadPathFile(const char* filename) override;
+	VGApplication* simplifyPaths(bool lossy, float max_zoom) override;
+	VGApplication* autoTuneKernals() override;
 
 // ------------------------------ inner function -----------------------------------------
 private:
@@ -45,6 +50,14 @@ private:
 
 	std::shared_ptr<VGContainer> _vgContainer;
 
+	// precompiled scene, mapped until the app exits
+	std::shared_ptr<BVG> _bvg;
+
+	bool _simplify = false;
+	VGSimplifyOptions _simplifyOptions;
+
+	bool _autoTune = false;
+
 	std::shared_ptr<VGRasterizer> _vgRasterizer;
 
 	Camera _camera;
@@ -147,12 +160,29 @@ void ScanlineVGApplication::run() {
 	if (!_init) {
 		initWindow();
 		_camera.init(_width, _height);
-		_vgRasterizer = std::make_shared<ScanlineVGRasterizer>();
+		auto rasterizer = std::make_shared<ScanlineVGRasterizer>();
+		rasterizer->setAutoTune(_autoTune);
+		_vgRasterizer = rasterizer;
 		_vgRasterizer->initialize(_window, _width, _height);
-		_vgRasterizer->loadVG(_vgContainer);
+		if (_bvg) {
+			_vgRasterizer->loadVG(_bvg->view());
+		}
+		else {
+			if (_simplify) {
+				VGSimplifyStats stats;
+				_vgContainer = simplifyVG(*_vgContainer, _simplifyOptions, &stats);
+				printf("simplify: %d -> %d curves, %d degenerate, %d demoted, %d merged\n"
+					, stats.curves_before, stats.curves_after
+					, stats.degenerate, stats.demoted, stats.merged);
+			}
+			_vgRasterizer->loadVG(_vgContainer);
+		}
 		_init = true;
 	}
 
+	// throughput over two second windows, meaningful with vsync off
+	auto window_begin = std::chrono::high_resolution_clock::now();
+	uint32_t window_frames = 0;
 	while (!glfwWindowShouldClose(_window)) {
 		glfwPollEvents();
 
@@ -160,6 +190,15 @@ void ScanlineVGApplication::run() {
 		_vgRasterizer->setMVP(glm::transpose(m));
 
 		_vgRasterizer->render();
+
+		++window_frames;
+		auto now = std::chrono::high_resolution_clock::now();
+		double window_ms = std::chrono::duration<double, std::milli>(now - window_begin).count();
+		if (window_ms >= 2000.0) {
+			printf("%.1f fps, %.2f ms/frame\n", window_frames * 1000.0 / window_ms, window_ms / window_frames);
+			window_begin = now;
+			window_frames = 0;
+		}
 	}
 
 }
@@ -184,13 +223,35 @@ VGApplication* ScanlineVGApplication::loadPathFile(const char* filename)
 	++ind;
 	if (fileStr[ind] == 'r') {
 		RVG rvg;
+		rvg.setShareEndpoints(true);
 		rvg.load(fileStr);
 		_vgContainer = rvg.getVGContainer();
+		_bvg.reset();
+	}
+	else if (fileStr[ind] == 'b') {
+		_vgContainer.reset();
+		_bvg = std::make_shared<BVG>();
+		_bvg->load(fileStr);
 	}
 	
 	return this;
 }
 
+VGApplication* ScanlineVGApplication::simplifyPaths(bool lossy, float max_zoom)
+{
+	// a precompiled bvg scene is uploaded as is
+	_simplify = true;
+	_simplifyOptions.lossy = lossy;
+	_simplifyOptions.max_zoom = max_zoom;
+	return this;
+}
+
+VGApplication* ScanlineVGApplication::autoTuneKernals()
+{
+	_autoTune = true;
+	return this;
+}
+
 VGApplication* ScanlineVGApplication::viewport(int x, int y, int w, int h) {
 	if (_vgRasterizer != nullptr) {
 		//_vgRasterizer->viewport(x, y, w, h);
@@ -10,6 +10,11 @@ public:
 	virtual VGApplication* appName(const char* name) = 0;
 	
 	virtual VGApplication* loadPathFile(const char* filename) = 0;
+	// clean up rvg geometry before upload without changing any pixel, or
+	// 'lossy' within 1/32 px up to 'max_zoom'
+	virtual VGApplication* simplifyPaths(bool lossy, float max_zoom) = 0;
+	// time the compute kernal work group sizes on the first frame, keep the fastest
+	virtual VGApplication* autoTuneKernals() = 0;
 };
 
 std::shared_ptr<VGApplication> getAppInstance();
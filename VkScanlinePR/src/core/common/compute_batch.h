@@ -0,0 +1,140 @@
+#pragma once
+#ifndef GALAXYSAILING_COMPUTE_BATCH_H_
+#define GALAXYSAILING_COMPUTE_BATCH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "../vk/vk_initializer.h"
+#include "../vk/vk_util.h"
+
+namespace Galaxysailing {
+
+using namespace std;
+
+/*
+* One command buffer several kernels record into with
+* ComputeKernal::record(), so a chain of dependent dispatches goes to
+* the queue in one submit. cmdBarrier() goes between a dispatch and the
+* ones that read what it wrote.
+*/
+class ComputeBatch {
+public:
+    ComputeBatch(VkDevice device, VkCommandPool compute_cmd_pool)
+        : _device(device)
+    {
+        VkCommandBufferAllocateInfo cmd_buf_alloc_info =
+            vk::initializer::commandBufferAllocateInfo(compute_cmd_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(_device, &cmd_buf_alloc_info, &cmd_buffer));
+
+        VkSemaphoreCreateInfo sem_ci = vk::initializer::semaphoreCreateInfo();
+        VK_CHECK_RESULT(vkCreateSemaphore(_device, &sem_ci, nullptr, &semaphore));
+    }
+
+    VkCommandBuffer begin() {
+        VkCommandBufferBeginInfo cmd_buf_info = vk::initializer::commandBufferBeginInfo();
+        cmd_buf_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(cmd_buffer, &cmd_buf_info));
+        return cmd_buffer;
+    }
+
+    // make the writes of the dispatches so far to 'buffers' visible to the
+    // dispatches after, everything before also finishes executing first
+    ComputeBatch* cmdBarrier(const vector<VkBuffer>& buffers) {
+        _barriers.clear();
+        for (VkBuffer buffer : buffers) {
+            VkBufferMemoryBarrier barrier = vk::initializer::bufferMemoryBarrier();
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            _barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+            , 0, 0, nullptr
+            , static_cast<uint32_t>(_barriers.size()), _barriers.data()
+            , 0, nullptr);
+        return this;
+    }
+
+    // order what is recorded after against all work submitted to the queue
+    // earlier, for buffers a submit shares with the ones before it
+    ComputeBatch* cmdQueueBarrier() {
+        VkMemoryBarrier barrier = vk::initializer::memoryBarrier();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        vkCmdPipelineBarrier(cmd_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        return this;
+    }
+
+    // like cmdBarrier(), also for the launch arguments the indirect
+    // dispatches after read from 'buffer'
+    ComputeBatch* cmdIndirectBarrier(VkBuffer buffer) {
+        VkBufferMemoryBarrier barrier = vk::initializer::bufferMemoryBarrier();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+            , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+            , 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        return this;
+    }
+
+    // release 'buffers' from this queue family to 'dst_family' after the
+    // dispatches and copies so far, the other queue acquires them with the
+    // same barrier before its first use
+    ComputeBatch* cmdRelease(const vector<VkBuffer>& buffers, uint32_t src_family, uint32_t dst_family) {
+        _barriers.clear();
+        for (VkBuffer buffer : buffers) {
+            VkBufferMemoryBarrier barrier = vk::initializer::bufferMemoryBarrier();
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.buffer = buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            _barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+            , VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+            , 0, 0, nullptr
+            , static_cast<uint32_t>(_barriers.size()), _barriers.data()
+            , 0, nullptr);
+        return this;
+    }
+
+    void end() {
+        VK_CHECK_RESULT(vkEndCommandBuffer(cmd_buffer));
+    }
+
+    VkSubmitInfo submitInfo(std::vector<VkSemaphore>& wait_sema, std::vector<VkSemaphore>& signal_sema, const VkPipelineStageFlags* wait_dst_stage_masks) {
+        VkSubmitInfo sub = vk::initializer::submitInfo();
+        sub.pWaitDstStageMask = wait_dst_stage_masks;
+        sub.waitSemaphoreCount = static_cast<uint32_t>(wait_sema.size());
+        sub.pWaitSemaphores = wait_sema.data();
+        signal_sema.push_back(semaphore);
+        sub.signalSemaphoreCount = static_cast<uint32_t>(signal_sema.size());
+        sub.pSignalSemaphores = signal_sema.data();
+        sub.commandBufferCount = 1;
+        sub.pCommandBuffers = &cmd_buffer;
+        return sub;
+    }
+
+private:
+    VkDevice _device = VK_NULL_HANDLE;
+    vector<VkBufferMemoryBarrier> _barriers;
+
+public:
+    VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+    VkSemaphore semaphore;
+};
+
+}
+
+#endif
@@ -0,0 +1,373 @@
+#pragma once
+#ifndef GALAXYSAILING_COMPUTE_GRAPH_H_
+#define GALAXYSAILING_COMPUTE_GRAPH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#include "../vk/vk_initializer.h"
+#include "../vk/vk_util.h"
+#include "compute_kernal.h"
+
+namespace Galaxysailing {
+
+using namespace std;
+
+/*
+* The compute passes of a frame and the buffer ranges each one reads and
+* writes, given as its descriptor bindings. Passes are added in program
+* order; compile() puts every pass one level after the latest pass it
+* conflicts with (read after write, write after read or write after
+* write on overlapping ranges). The passes of a level are independent
+* and recorded back to back, one barrier goes between levels. record()
+* pushes the descriptor sets and push constants declared with each pass.
+*/
+class ComputeGraph {
+public:
+    enum Access : uint32_t {
+        ACCESS_READ = 1,
+        ACCESS_WRITE = 2,
+        ACCESS_READ_WRITE = 3
+    };
+
+    class Pass {
+    public:
+        Pass* uniform(uint32_t binding, const VkDescriptorBufferInfo& info) {
+            return bind(binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, info, 0);
+        }
+        Pass* read(uint32_t binding, const VkDescriptorBufferInfo& info) {
+            return bind(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, info, ACCESS_READ);
+        }
+        Pass* write(uint32_t binding, const VkDescriptorBufferInfo& info) {
+            return bind(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, info, ACCESS_WRITE);
+        }
+        Pass* readWrite(uint32_t binding, const VkDescriptorBufferInfo& info) {
+            return bind(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, info, ACCESS_READ_WRITE);
+        }
+
+        // the value is copied, it doesn't have to outlive the call
+        Pass* pushConst(uint32_t offset, uint32_t size, const void* values) {
+            PushConst push = { offset, size, static_cast<uint32_t>(_push_data.size()) };
+            _push_data.resize(_push_data.size() + size);
+            memcpy(_push_data.data() + push.start, values, size);
+            _push_consts.push_back(push);
+            return this;
+        }
+
+        Pass* dispatch(uint32_t groupX, uint32_t groupY = 1) {
+            _group_x = groupX;
+            _group_y = groupY;
+            return this;
+        }
+
+        // group counts read from a VkDispatchIndirectCommand at 'offset' of 'buffer'
+        Pass* dispatchIndirect(VkBuffer buffer, VkDeviceSize offset) {
+            _indirect = buffer;
+            _indirect_offset = offset;
+            return this;
+        }
+
+        const string& name() const { return _name; }
+        uint32_t level() const { return _level; }
+
+    private:
+        friend class ComputeGraph;
+
+        struct Binding {
+            uint32_t binding;
+            VkDescriptorType type;
+            VkDescriptorBufferInfo info;
+            uint32_t access;
+        };
+        struct PushConst {
+            uint32_t offset;
+            uint32_t size;
+            uint32_t start;
+        };
+
+        Pass* bind(uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo& info, uint32_t access) {
+            _bindings.push_back({ binding, type, info, access });
+            return this;
+        }
+
+        string _name;
+        ComputeKernal* _kernal = nullptr;
+        vector<Binding> _bindings;
+        vector<PushConst> _push_consts;
+        vector<uint8_t> _push_data;
+        uint32_t _group_x = 1;
+        uint32_t _group_y = 1;
+        VkBuffer _indirect = VK_NULL_HANDLE;
+        VkDeviceSize _indirect_offset = 0;
+
+        uint32_t _level = 0;
+        // passes of the level before this one it waits for
+        vector<uint32_t> _after;
+    };
+
+    // 'timestamp_period' is VkPhysicalDeviceLimits::timestampPeriod, 0
+    // when the queue can't write timestamps and passes aren't timed
+    ComputeGraph(VkDevice device, float timestamp_period)
+        : _device(device),
+        _timestamp_period(timestamp_period)
+    {
+        if (_timestamp_period > 0.0f) {
+            VkQueryPoolCreateInfo query_pool_ci = {};
+            query_pool_ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_ci.queryCount = MAX_LEVELS + 1;
+            VK_CHECK_RESULT(vkCreateQueryPool(_device, &query_pool_ci, nullptr, &_query_pool));
+        }
+    }
+
+    ~ComputeGraph() {
+        if (_query_pool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(_device, _query_pool, nullptr);
+        }
+    }
+
+    ComputeGraph(const ComputeGraph&) = delete;
+    ComputeGraph& operator=(const ComputeGraph&) = delete;
+
+    // drop the passes, the timings of the last record() go with them
+    void reset() {
+        _passes.clear();
+        _n_levels = 0;
+        _level_ms.clear();
+        _recorded = false;
+    }
+
+    Pass* addPass(const string& name, ComputeKernal& kernal) {
+        _passes.push_back(std::make_unique<Pass>());
+        Pass* pass = _passes.back().get();
+        pass->_name = name;
+        pass->_kernal = &kernal;
+        return pass;
+    }
+
+    void compile() {
+        _n_levels = 0;
+        for (uint32_t i = 0; i < _passes.size(); ++i) {
+            Pass& pass = *_passes[i];
+            pass._level = 0;
+            pass._after.clear();
+            for (uint32_t j = 0; j < i; ++j) {
+                if (conflicts(*_passes[j], pass)) {
+                    pass._level = (std::max)(pass._level, _passes[j]->_level + 1);
+                }
+            }
+            for (uint32_t j = 0; j < i; ++j) {
+                if (_passes[j]->_level + 1 == pass._level && conflicts(*_passes[j], pass)) {
+                    pass._after.push_back(j);
+                }
+            }
+            _n_levels = (std::max)(_n_levels, pass._level + 1);
+        }
+        if (_query_pool != VK_NULL_HANDLE && _n_levels > MAX_LEVELS) {
+            throw std::runtime_error("ComputeGraph: more levels than timestamps");
+        }
+    }
+
+    uint32_t levelCount() const { return _n_levels; }
+
+    // levels of the first and last pass that bind 'buffer', false when none does
+    bool lifetime(VkBuffer buffer, uint32_t& first, uint32_t& last) const {
+        bool used = false;
+        for (auto& pass : _passes) {
+            bool binds = pass->_indirect == buffer;
+            for (auto& b : pass->_bindings) {
+                binds = binds || b.info.buffer == buffer;
+            }
+            if (!binds) {
+                continue;
+            }
+            first = used ? (std::min)(first, pass->_level) : pass->_level;
+            last = used ? (std::max)(last, pass->_level) : pass->_level;
+            used = true;
+        }
+        return used;
+    }
+
+    void record(VkCommandBuffer cmd) {
+        bool timed = _query_pool != VK_NULL_HANDLE;
+        if (timed) {
+            vkCmdResetQueryPool(cmd, _query_pool, 0, _n_levels + 1);
+            vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _query_pool, 0);
+        }
+        vector<VkWriteDescriptorSet> write_desc_sets;
+        for (uint32_t level = 0; level < _n_levels; ++level) {
+            if (level > 0) {
+                cmdLevelBarrier(cmd, level);
+            }
+            for (auto& p : _passes) {
+                Pass& pass = *p;
+                if (pass._level != level) {
+                    continue;
+                }
+                write_desc_sets.clear();
+                for (auto& b : pass._bindings) {
+                    VkWriteDescriptorSet write = vk::initializer::writeDescriptorSet(VK_NULL_HANDLE, b.type, b.binding, &b.info);
+                    write_desc_sets.push_back(write);
+                }
+                pass._kernal->record(cmd)->cmdPushDescSet(write_desc_sets);
+                for (auto& push : pass._push_consts) {
+                    pass._kernal->cmdPushConst(push.offset, push.size, pass._push_data.data() + push.start);
+                }
+                if (pass._indirect != VK_NULL_HANDLE) {
+                    pass._kernal->cmdDispatchIndirect(pass._indirect, pass._indirect_offset);
+                }
+                else {
+                    pass._kernal->cmdDispatch(pass._group_x, pass._group_y);
+                }
+            }
+            if (timed) {
+                vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _query_pool, level + 1);
+            }
+        }
+        _recorded = true;
+    }
+
+    // read the timestamps of the last record(), its submit must be done
+    bool collectTimings() {
+        if (_query_pool == VK_NULL_HANDLE || !_recorded || _n_levels == 0) {
+            return false;
+        }
+        vector<uint64_t> stamps(_n_levels + 1);
+        VkResult res = vkGetQueryPoolResults(_device, _query_pool, 0, _n_levels + 1
+            , stamps.size() * sizeof(uint64_t), stamps.data(), sizeof(uint64_t)
+            , VK_QUERY_RESULT_64_BIT);
+        if (res != VK_SUCCESS) {
+            return false;
+        }
+        _level_ms.resize(_n_levels);
+        for (uint32_t level = 0; level < _n_levels; ++level) {
+            _level_ms[level] = (stamps[level + 1] - stamps[level]) * _timestamp_period / 1e6;
+        }
+        return true;
+    }
+
+    // milliseconds of all levels, after collectTimings()
+    double totalMs() const {
+        double total_ms = 0.0;
+        for (double ms : _level_ms) {
+            total_ms += ms;
+        }
+        return total_ms;
+    }
+
+    // print the levels, their passes and what each pass waits for, with
+    // the times collectTimings() read; passes sharing a level share its time
+    void dump() const {
+        double total_ms = 0.0;
+        printf("compute graph: %zu passes in %u levels\n", _passes.size(), _n_levels);
+        for (uint32_t level = 0; level < _n_levels; ++level) {
+            if (level < _level_ms.size()) {
+                printf("  level %u: %.3f ms\n", level, _level_ms[level]);
+                total_ms += _level_ms[level];
+            }
+            else {
+                printf("  level %u\n", level);
+            }
+            for (auto& pass : _passes) {
+                if (pass->_level != level) {
+                    continue;
+                }
+                string after;
+                for (uint32_t j : pass->_after) {
+                    after += (after.empty() ? "" : ", ") + _passes[j]->_name;
+                }
+                printf("    %-32s%s%s%s\n", pass->_name.c_str()
+                    , pass->_indirect != VK_NULL_HANDLE ? " (indirect)" : ""
+                    , after.empty() ? "" : " after "
+                    , after.c_str());
+            }
+        }
+        if (!_level_ms.empty()) {
+            printf("  total %.3f ms\n", total_ms);
+        }
+    }
+
+private:
+    static bool overlaps(const VkDescriptorBufferInfo& a, const VkDescriptorBufferInfo& b) {
+        if (a.buffer != b.buffer) {
+            return false;
+        }
+        VkDeviceSize a_end = a.range == VK_WHOLE_SIZE ? ~VkDeviceSize(0) : a.offset + a.range;
+        VkDeviceSize b_end = b.range == VK_WHOLE_SIZE ? ~VkDeviceSize(0) : b.offset + b.range;
+        return a.offset < b_end && b.offset < a_end;
+    }
+
+    // the indirect arguments are read like a binding
+    static void accesses(const Pass& pass, vector<pair<VkDescriptorBufferInfo, uint32_t>>& out) {
+        out.clear();
+        for (auto& b : pass._bindings) {
+            if (b.access != 0) {
+                out.push_back({ b.info, b.access });
+            }
+        }
+        if (pass._indirect != VK_NULL_HANDLE) {
+            VkDescriptorBufferInfo args = { pass._indirect, pass._indirect_offset, sizeof(VkDispatchIndirectCommand) };
+            out.push_back({ args, ACCESS_READ });
+        }
+    }
+
+    bool conflicts(const Pass& before, const Pass& after) {
+        accesses(before, _scratch_a);
+        accesses(after, _scratch_b);
+        for (auto& a : _scratch_a) {
+            for (auto& b : _scratch_b) {
+                if (((a.second | b.second) & ACCESS_WRITE) && overlaps(a.first, b.first)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /*
+    * One memory barrier for everything the level waits for. It also orders
+    * buffers that alias the memory of buffers in earlier levels, which the
+    * graph doesn't see as the same range.
+    */
+    void cmdLevelBarrier(VkCommandBuffer cmd, uint32_t level) {
+        bool indirect = false;
+        for (auto& pass : _passes) {
+            indirect = indirect || (pass->_level == level && pass->_indirect != VK_NULL_HANDLE);
+        }
+        VkMemoryBarrier barrier = vk::initializer::memoryBarrier();
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        if (indirect) {
+            barrier.dstAccessMask |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            dst_stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages
+            , 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    static const uint32_t MAX_LEVELS = 64;
+
+    VkDevice _device = VK_NULL_HANDLE;
+    float _timestamp_period = 0.0f;
+    VkQueryPool _query_pool = VK_NULL_HANDLE;
+
+    vector<std::unique_ptr<Pass>> _passes;
+    uint32_t _n_levels = 0;
+    vector<double> _level_ms;
+    bool _recorded = false;
+
+    vector<pair<VkDescriptorBufferInfo, uint32_t>> _scratch_a;
+    vector<pair<VkDescriptorBufferInfo, uint32_t>> _scratch_b;
+};
+
+}
+
+#endif
@@ -14,6 +14,36 @@ namespace Galaxysailing {
 
 using namespace std;
 
+/*
+* 32-bit specialization constants of a kernel by constant_id, constants
+* the shader doesn't declare are ignored
+*/
+class KernalSpecialization {
+public:
+    KernalSpecialization* set(uint32_t id, uint32_t value) {
+        VkSpecializationMapEntry entry;
+        entry.constantID = id;
+        entry.offset = static_cast<uint32_t>(_data.size() * sizeof(uint32_t));
+        entry.size = sizeof(uint32_t);
+        _entries.push_back(entry);
+        _data.push_back(value);
+        return this;
+    }
+
+    // valid until the next set()
+    const VkSpecializationInfo* info() {
+        _info.mapEntryCount = static_cast<uint32_t>(_entries.size());
+        _info.pMapEntries = _entries.data();
+        _info.dataSize = _data.size() * sizeof(uint32_t);
+        _info.pData = _data.data();
+        return &_info;
+    }
+
+private:
+    vector<VkSpecializationMapEntry> _entries;
+    vector<uint32_t> _data;
+    VkSpecializationInfo _info = {};
+};
 
 class ComputeKernal {
 public:
@@ -25,10 +55,12 @@ public:
         , bool push_desc
         , const VkPipelineShaderStageCreateInfo &shader_stage_ci
         , PFN_vkCmdPushDescriptorSetKHR pfn_push_desc
-        , vector<VkPushConstantRange>* push_const_range = nullptr)
+        , vector<VkPushConstantRange>* push_const_range = nullptr
+        , const VkSpecializationInfo* spec_info = nullptr)
         : _device(device),
         _pipeline_cache(ppl_cache),
-        _vkCmdPushDescriptorSetKHR(pfn_push_desc) 
+        _vkCmdPushDescriptorSetKHR(pfn_push_desc),
+        _cmd_pool(compute_cmd_pool)
     {
         // layout binding
         vector<VkDescriptorSetLayoutBinding> ds_layout_bindings;
@@ -58,6 +90,7 @@ public:
 
         VkComputePipelineCreateInfo compute_ppl_ci = vk::initializer::computePipelineCreateInfo(_pipeline_layout, 0);
         compute_ppl_ci.stage = shader_stage_ci;
+        compute_ppl_ci.stage.pSpecializationInfo = spec_info;
         VK_CHECK_RESULT(vkCreateComputePipelines(_device, _pipeline_cache, 1, &compute_ppl_ci, nullptr, &_pipeline));
 
         // Create a command buffer for compute operations
@@ -70,22 +103,44 @@ public:
         VK_CHECK_RESULT(vkCreateSemaphore(_device, &sem_ci, nullptr, &semaphore));
     }
 
+    // the kernels are rebuilt with other specialization constants, the
+    // device must be done with this one
+    ~ComputeKernal() {
+        vkFreeCommandBuffers(_device, _cmd_pool, 1, &cmd_buffer);
+        vkDestroySemaphore(_device, semaphore, nullptr);
+        vkDestroyPipeline(_device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(_device, _pipeline_layout, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _desc_set_layout, nullptr);
+    }
+
+    ComputeKernal(const ComputeKernal&) = delete;
+    ComputeKernal& operator=(const ComputeKernal&) = delete;
+
     // ---------------------- command ------------------------------
     ComputeKernal* beginCmdBuffer(bool one_time = false) {
         VkCommandBufferBeginInfo cmd_buf_info = vk::initializer::commandBufferBeginInfo();
         cmd_buf_info.flags = one_time ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
         VK_CHECK_RESULT(vkBeginCommandBuffer(cmd_buffer, &cmd_buf_info));
-        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        _target = cmd_buffer;
+        vkCmdBindPipeline(_target, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        return this;
+    }
+
+    // record into 'cmd', a command buffer shared with other kernels, the
+    // cmd* calls after this go there until the next beginCmdBuffer()
+    ComputeKernal* record(VkCommandBuffer cmd) {
+        _target = cmd;
+        vkCmdBindPipeline(_target, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
         return this;
     }
 
     ComputeKernal* cmdPushConst(uint32_t offset, uint32_t size, const void* pValues) {
-        vkCmdPushConstants(cmd_buffer, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, pValues);
+        vkCmdPushConstants(_target, _pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, pValues);
         return this;
     }
 
     ComputeKernal* cmdPushDescSet(const vector<VkWriteDescriptorSet>& write_desc_sets) {
-        _vkCmdPushDescriptorSetKHR(cmd_buffer
+        _vkCmdPushDescriptorSetKHR(_target
             , VK_PIPELINE_BIND_POINT_COMPUTE
             , _pipeline_layout
             , 0
@@ -95,7 +150,13 @@ public:
     }
 
     ComputeKernal* cmdDispatch(uint32_t groupX, uint32_t groupY = 1) {
-        vkCmdDispatch(cmd_buffer, groupX, groupY, 1);
+        vkCmdDispatch(_target, groupX, groupY, 1);
+        return this;
+    }
+
+    // group counts read from a VkDispatchIndirectCommand at 'offset' of 'buffer'
+    ComputeKernal* cmdDispatchIndirect(VkBuffer buffer, VkDeviceSize offset) {
+        vkCmdDispatchIndirect(_target, buffer, offset);
         return this;
     }
 
@@ -154,8 +215,11 @@ private:
     VkPipelineLayout _pipeline_layout = VK_NULL_HANDLE;
     //VkDescriptorSet desc_set;
     VkPipeline _pipeline = VK_NULL_HANDLE;
+    VkCommandPool _cmd_pool = VK_NULL_HANDLE;
 
     bool _push_desc = true;
+    // where the cmd* calls record
+    VkCommandBuffer _target = VK_NULL_HANDLE;
 
 
 public:
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef GALAXYSAILING_THREAD_POOL_H_
+#define GALAXYSAILING_THREAD_POOL_H_
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+namespace Galaxysailing {
+
+/*
+* Fixed size pool of worker threads for CPU side data preparation.
+*/
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t n_threads = 0) {
+		if (n_threads == 0) {
+			n_threads = (std::max)(1u, std::thread::hardware_concurrency());
+		}
+		for (size_t i = 0; i < n_threads; ++i) {
+			_workers.emplace_back([this] { workerLoop(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cv.notify_all();
+		for (auto& w : _workers) {
+			w.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// process wide pool, created on first use
+	static ThreadPool& shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	size_t size() const { return _workers.size(); }
+
+	template<class F>
+	auto submit(F&& f) -> std::future<decltype(f())> {
+		using R = decltype(f());
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		std::future<R> res = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_tasks.emplace([task] { (*task)(); });
+		}
+		_cv.notify_one();
+		return res;
+	}
+
+	// run fn(i) for i in [0, n), wait for all of them and rethrow the first error
+	// (must not be called from inside a pool task)
+	template<class F>
+	void parallelFor(size_t n, F&& fn) {
+		std::vector<std::future<void>> futures;
+		futures.reserve(n);
+		for (size_t i = 0; i < n; ++i) {
+			futures.push_back(submit([&fn, i] { fn(i); }));
+		}
+		std::exception_ptr err;
+		for (auto& f : futures) {
+			try {
+				f.get();
+			}
+			catch (...) {
+				if (!err) { err = std::current_exception(); }
+			}
+		}
+		if (err) {
+			std::rethrow_exception(err);
+		}
+	}
+
+private:
+	void workerLoop() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+				if (_stop && _tasks.empty()) {
+					return;
+				}
+				task = std::move(_tasks.front());
+				_tasks.pop();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> _workers;
+	std::queue<std::function<void()>> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	bool _stop = false;
+};
+
+}
+
+#endif
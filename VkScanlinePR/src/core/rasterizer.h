@@ -3,6 +3,7 @@
 #define GALAXYSAILING_RASTERIZER_H_
 
 #include "vg/vg_container.h"
+#include "vg/vg_scene.h"
 
 namespace Galaxysailing {
 
@@ -14,8 +15,15 @@ public:
 
     virtual void loadVG(std::shared_ptr<VGContainer> vg) = 0;
 
+    // upload an already flattened scene, e.g. a mapped .bvg file
+    virtual void loadVG(const VGSceneView& scene) = 0;
+
     virtual void setMVP(const glm::mat4& m) = 0;
 
+    // overwrite the dyn_affine of paths [first_path, first_path + count),
+    // only the transform buffer is written, the geometry stays on the GPU
+    virtual void setPathTransforms(uint32_t first_path, const glm::mat3x2* m, uint32_t count) = 0;
+
 	//virtual void viewport(int x, int y, int w, int h) = 0;
 };
 
@@ -14,7 +14,7 @@ struct TransPosIn {
 
 struct MakeInteIn {
     uint32_t n_curves;
-    uint32_t n_fragments;
+    uint32_t max_fragments;
     int w, h;
 };
 };
@@ -12,18 +12,21 @@
 
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <cstdio>
 
 #include <GLFW/glfw3.h>
 
-#define GPU_VULKAN_BUFFER(T) NEW_VULKAN_BUFFER(T, _vulkanDevice, usage_flags, memory_property_flags, queue)
+#define GPU_VULKAN_BUFFER(T) NEW_VULKAN_BUFFER(T, _vulkanDevice, usage_flags, memory_property_flags, queue, queue_family)
 
-#define COMPUTE_KERNAL(desc_types, shader, pcr) std::make_shared<ComputeKernal>(_device, _pipelineCache \
+#define COMPUTE_KERNAL(desc_types, shader, pcr, spec) std::make_shared<ComputeKernal>(_device, _pipelineCache \
 , desc_types                                                                                       \
 , _compute.cmd_pool                                                                         \
 , true                                                                                      \
 , loadShader(shader, VK_SHADER_STAGE_COMPUTE_BIT)                                           \
 , _vkCmdPushDescriptorSetKHR                                                        \
-, pcr)                   
+, pcr                                                                               \
+, spec)                   
 
 #define DESC_TYPE_SB VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
 #define DESC_TYPE_UB VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
@@ -34,6 +37,15 @@
 
 inline int divup(int a, int b) { return (a + (b - 1)) / b; }
 
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
 namespace Galaxysailing {
 
 using _Base = Galaxysailing::VulkanVGRasterizerBase;
@@ -52,6 +64,10 @@ void ScanlineVGRasterizer::initialize(void *window, uint32_t w, uint32_t h)
 
     // Create a compute capable device queue
     vkGetDeviceQueue(_device, _vulkanDevice->queueFamilyIndices.compute, 0, &_compute.queue);
+    _compute.async = _vulkanDevice->queueFamilyIndices.compute != _vulkanDevice->queueFamilyIndices.graphics;
+    printf("compute queue family %u, graphics queue family %u%s\n"
+        , _vulkanDevice->queueFamilyIndices.compute, _vulkanDevice->queueFamilyIndices.graphics
+        , _compute.async ? ", async compute" : "");
 }
 
 void ScanlineVGRasterizer::render()
@@ -66,109 +82,98 @@ void ScanlineVGRasterizer::render()
 
 void ScanlineVGRasterizer::loadVG(std::shared_ptr<VGContainer> vg_input)
 {
-    auto& vg = *vg_input;
-
-    auto& point = vg.pointData;
-    auto& curve = vg.curveData;
-    auto& path = vg.pathData;
-    
-    int n_paths = path.pathIndex + 1;
-    int n_curves = curve.curveIndex + 1;
-    int n_points = point.pos.size();
-
-    using std::vector;
-    using namespace glm;
-
-    // point 
-    vector<vec2> position;
-    vector<uint32_t> pos_path_idx;
-    position.reserve(n_points);
-    pos_path_idx.reserve(n_points);
-
-    // curve
-    vector<uint32_t> curve_pos_map;
-    vector<uint32_t> curve_type;
-    vector<uint32_t> curve_path_idx;
-    //curve_pos_map.reserve(n_curves + 1);
-    curve_type.reserve(n_curves);
-    curve_path_idx.reserve(n_curves);
-
-    // path
-    vector<uint32_t> path_fill_rule;
-    vector<uint32_t> path_fill_info;
-    path_fill_rule.reserve(n_paths);
-    path_fill_info.reserve(n_paths);
-
-    for (uint32_t pi = 0; pi < n_paths; ++pi) {
-        uint32_t path_idx = pi;
-        uint32_t curve_begin = path.curveIndices[pi];
-        uint32_t curve_end = (pi != n_paths - 1 ? path.curveIndices[pi + 1] : n_curves);
-        
-        // process fill color
-        glm::vec4& color = path.fillColor[pi];
-        color.a *= path.fillOpacity[pi];
-        color *= 255.0f;
-        uint8_t col[4];
-#pragma unroll
-        for (int i = 0; i < 4; ++i) {
-            col[i] = static_cast<uint8_t>(color[i]);
-        }
-        uint32_t c = *((uint32_t*)col);
-        c = c & 0xFF000000 ? c : 0;
-        path_fill_info.push_back(c);
-
-        // process fill rule
-        path_fill_rule.push_back(static_cast<uint32_t>(path.fillRule[pi]));
-
-        for (uint32_t ci = curve_begin; ci < curve_end; ++ci) {
-            uint32_t curve_idx = ci;
-            uint32_t point_begin = curve.posIndices[ci];
-            uint32_t point_end = (ci != n_curves - 1 ? curve.posIndices[ci + 1] : n_points);
-            curve_path_idx.push_back(path_idx);
-            curve_pos_map.push_back(point_begin);
-            curve_type.push_back(static_cast<uint32_t>(curve.curveType[ci]));
-            for (uint32_t poi = point_begin; poi < point_end; ++poi) {
-                position.push_back(point.pos[poi]);
-                pos_path_idx.push_back(path_idx);
-            }
-        }
-    }
-
-    // record final curve-pos map
-    //curve_pos_map.push_back(n_points - 1);
+    VGScene scene(*vg_input);
+    auto& t = scene.timing;
+    printf("loadVG flatten: %.2f ms (layout %.2f, count %.2f, geometry %.2f, path %.2f)\n"
+        , t.total_ms(), t.layout_ms, t.count_ms, t.geometry_ms, t.path_ms);
+    loadVG(scene.view());
+}
 
+void ScanlineVGRasterizer::loadVG(const VGSceneView& scene)
+{
+    auto& _in_geom = _compute.geometry_input;
     auto& _in_curve = _compute.curve_input;
     auto& _in_path = _compute.path_input;
 
+    auto t0 = std::chrono::high_resolution_clock::now();
+
     VkQueue queue = _compute.queue;
+    uint32_t queue_family = _vulkanDevice->queueFamilyIndices.compute;
     VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT 
         | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT 
         | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    _in_curve.position = GPU_VULKAN_BUFFER(vec2);
+    _in_geom.position = GPU_VULKAN_BUFFER(vec2);
+    _in_geom.curve_position_map = GPU_VULKAN_BUFFER(uint32_t);
+    _in_geom.curve_type = GPU_VULKAN_BUFFER(uint8_t);
+    _in_geom.curve_arc_w = GPU_VULKAN_BUFFER(float);
+    _in_geom.point_begin = GPU_VULKAN_BUFFER(uint32_t);
+    _in_geom.curve_begin = GPU_VULKAN_BUFFER(uint32_t);
+
+    // path i drawing geometry i needs no curve expansion, the curve
+    // arrays are the geometry ones
+    bool paths_are_geometries = scene.n_geometries == scene.n_paths;
+    for (uint32_t i = 0; paths_are_geometries && i < scene.n_paths; ++i) {
+        paths_are_geometries = scene.path_geometry.data[i] == i;
+    }
+    _in_curve.paths_are_geometries = paths_are_geometries;
     _in_curve.position_path_idx = GPU_VULKAN_BUFFER(uint32_t);
-
-    _in_curve.curve_position_map = GPU_VULKAN_BUFFER(uint32_t);
-    _in_curve.curve_type = GPU_VULKAN_BUFFER(uint32_t);
     _in_curve.curve_path_idx = GPU_VULKAN_BUFFER(uint32_t);
-
-    _in_curve.n_curves = n_curves;
-    _in_curve.n_points = n_points;
+    if (paths_are_geometries) {
+        _in_curve.curve_position_map = _in_geom.curve_position_map;
+        _in_curve.curve_type = _in_geom.curve_type;
+        _in_curve.curve_arc_w = _in_geom.curve_arc_w;
+    }
+    else {
+        _in_curve.curve_position_map = GPU_VULKAN_BUFFER(uint32_t);
+        _in_curve.curve_type = GPU_VULKAN_BUFFER(uint8_t);
+        _in_curve.curve_arc_w = GPU_VULKAN_BUFFER(float);
+    }
 
     _in_path.fill_info = GPU_VULKAN_BUFFER(uint32_t);
-    _in_path.fill_rule = GPU_VULKAN_BUFFER(uint32_t);
-
-    _in_curve.position->set(position);
-    _in_curve.position_path_idx->set(pos_path_idx);
-
-    _in_curve.curve_position_map->set(curve_pos_map);
-    _in_curve.curve_type->set(curve_type);
-    _in_curve.curve_path_idx->set(curve_path_idx);
-
-    _in_path.n_paths = n_paths;
-    _in_path.fill_info->set(path_fill_info);
-    _in_path.fill_rule->set(path_fill_rule);
+    _in_path.fill_rule = GPU_VULKAN_BUFFER(uint8_t);
+    _in_path.transform = GPU_VULKAN_BUFFER(mat3x2);
+    _in_path.geometry = GPU_VULKAN_BUFFER(uint32_t);
+    _in_path.point_begin = GPU_VULKAN_BUFFER(uint32_t);
+    _in_path.curve_begin = GPU_VULKAN_BUFFER(uint32_t);
+
+    // every section goes through one staging arena and one submit
+    vulkan::UploadBatch upload(_vulkanDevice, queue);
+    _in_geom.n_geometries = scene.n_geometries;
+    upload.add(_in_geom.position, scene.position.data, scene.position.size);
+    upload.add(_in_geom.curve_position_map, scene.curve_position_map.data, scene.curve_position_map.size);
+    upload.add(_in_geom.curve_type, scene.curve_type.data, scene.curve_type.size);
+    upload.add(_in_geom.curve_arc_w, scene.curve_arc_w.data, scene.curve_arc_w.size);
+    upload.add(_in_geom.point_begin, scene.geometry_point_begin.data, scene.geometry_point_begin.size);
+    upload.add(_in_geom.curve_begin, scene.geometry_curve_begin.data, scene.geometry_curve_begin.size);
+
+    _in_path.n_paths = scene.n_paths;
+    upload.add(_in_path.fill_info, scene.fill_info.data, scene.fill_info.size);
+    upload.add(_in_path.fill_rule, scene.fill_rule.data, scene.fill_rule.size);
+    upload.add(_in_path.transform, scene.path_transform.data, scene.path_transform.size);
+    upload.add(_in_path.geometry, scene.path_geometry.data, scene.path_geometry.size);
+    upload.add(_in_path.point_begin, scene.path_point_begin.data, scene.path_point_begin.size);
+    upload.add(_in_path.curve_begin, scene.path_curve_begin.data, scene.path_curve_begin.size);
+    VkDeviceSize staged = upload.size();
+    upload.submit();
+    ++_scene_generation;
+
+    // instances are expanded into these by the next recordCompute
+    _compute.expand_pending = true;
+    _in_curve.n_curves = scene.n_curves;
+    _in_curve.n_points = scene.n_points;
+    _in_curve.position_path_idx->resizeWithoutCopy(scene.n_points);
+    _in_curve.curve_path_idx->resizeWithoutCopy(scene.n_curves);
+    if (!paths_are_geometries) {
+        _in_curve.curve_position_map->resizeWithoutCopy(scene.n_curves);
+        _in_curve.curve_type->resizeWithoutCopy(vgPackedBytes(scene.n_curves));
+        _in_curve.curve_arc_w->resizeWithoutCopy(scene.n_curves);
+    }
 
+    auto t1 = std::chrono::high_resolution_clock::now();
+    printf("loadVG upload: %.2f ms (%u geometries, %u paths, %u curves, %.1f KiB in one submit)\n"
+        , std::chrono::duration<double, std::milli>(t1 - t0).count()
+        , scene.n_geometries, scene.n_paths, scene.n_curves, staged / 1024.0);
 
     // debug
     //uint32* ptr = (uint32*)_in_curve.curve_type->cptr();
@@ -196,6 +201,24 @@ void ScanlineVGRasterizer::setMVP(const glm::mat4& m)
     _compute.trans_pos_in.m3 = m[3];
 }
 
+void ScanlineVGRasterizer::setPathTransforms(uint32_t first_path, const glm::mat3x2* m, uint32_t count)
+{
+    auto& _in_path = _compute.path_input;
+    if (!_in_path.transform || first_path + count > _in_path.n_paths) {
+        throw std::runtime_error("ScanlineVGRasterizer::setPathTransforms path out of range");
+    }
+    // edits ride the next frame's upload ring, copied ahead of transform_pos
+    // behind the barrier against the frames still in flight; before the
+    // first frame nothing reads the buffer yet
+    if (_compute.upload_ring) {
+        _compute.upload_ring->stage(_in_path.transform, m, first_path, count);
+    }
+    else {
+        _in_path.transform->update(m, first_path, count);
+    }
+    ++_scene_generation;
+}
+
 //void ScanlineVGRasterizer::viewport(int x, int y, int w, int h)
 //{
 //    if (!_initialized) {
@@ -230,11 +253,19 @@ void ScanlineVGRasterizer::prepare()
     deviceProps2.pNext = &pushDescriptorProps;
     vkGetPhysicalDeviceProperties2KHR(_physicalDevice, &deviceProps2);
 
+    auto pipelines_begin = std::chrono::high_resolution_clock::now();
     prepareGraphics();
 
     prepareComputeBuffers();
+    loadKernalConfig();
     prepareCompute();
+    pipelinesBuilt(std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - pipelines_begin).count());
     _prepared = true;
+
+    if (_auto_tune) {
+        autoTuneKernal();
+    }
 }
 
 void ScanlineVGRasterizer::getEnabledFeatures()
@@ -281,341 +312,50 @@ void ScanlineVGRasterizer::mockDataload() {
 }
 void ScanlineVGRasterizer::drawFrame()
 {   
+    // frames in flight: wait for the one that last used this slot
+    _Base::beginFrame();
 #ifndef MOCK_DATA
-    //vkWaitForFences(_device, 1, &_compute.fence, VK_TRUE, UINT64_MAX);
-    VkSemaphore wait_compute;
-    auto& k_scan = *(_kernal.scan);
-
-    auto& k_transform_pos = *(_kernal.transform_pos);
-    auto& k_make_inte_0 = *(_kernal.make_intersection_0);
-    auto& k_make_inte_1 = *(_kernal.make_intersection_1);
-    auto& k_gen_fragment = *(_kernal.gen_fragment);
-    auto& k_seg_sort = *(_kernal.seg_sort);
-    auto& k_shuffle_fragment = *(_kernal.shuffle_fragment);
-    auto& k_mark_merged_fragment_and_span = *(_kernal.mark_merged_fragment_and_span);
-    auto& k_gen_merged_fragment_and_span = *(_kernal.gen_merged_fragment_and_span);
-
-    static bool is_first_draw = true;
-    std::vector<VkPipelineStageFlags> wait_dst_stage_masks = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
-
-    _compute.uniform_buffers.k_trans_pos_ubo->set(_compute.trans_pos_in, 1);
-
-    // transform position
-    std::vector<VkSemaphore> wait_sema = {};
-    std::vector<VkSemaphore> signal_sema = {};
-    VkSubmitInfo transpos_submit = k_transform_pos.submitInfo(is_first_draw
-        , wait_sema
-        , signal_sema
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &transpos_submit, VK_NULL_HANDLE));
-    wait_compute = k_transform_pos.semaphore;
-
-    is_first_draw = false;
-
-    // make intersection 0
-    VkSubmitInfo make_inte_0_submit = k_make_inte_0.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = {}
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &make_inte_0_submit, VK_NULL_HANDLE));
-    wait_compute = k_make_inte_0.semaphore;
-
-    //drawDebug();
-
-    uint32_t n_curves = _compute.curve_input.n_curves;
-    int32_t n_fragments = 0;
-
+    VkSemaphore wait_compute = VK_NULL_HANDLE;
     auto& _c = _compute;
-    auto& _cub = _compute.uniform_buffers;
-    auto& _csb = _compute.storage_buffers;
-    auto& _in_curve = _c.curve_input;
-    auto& _in_path = _c.path_input;
-
-    std::vector<VkWriteDescriptorSet> write_desc_sets;
-    // exclusive scan
-    {
-        auto& csb_curve_pixel_count = *_csb.curve_pixel_count;
-        write_desc_sets = {
-            PUSH_SB_WRITE_DESC_SET(0, &csb_curve_pixel_count.desc.buf_info),
-            PUSH_SB_WRITE_DESC_SET(1, &csb_curve_pixel_count.desc.buf_info)
-        };
-        k_scan.beginCmdBuffer(true)
-            ->cmdPushDescSet(write_desc_sets)
-            ->cmdPushConst(0, 4, &_compute.curve_input.n_curves)
-            ->cmdDispatch(1)
-            ->endCmdBuffer();
-        VkSubmitInfo scan_submit = k_scan.submitInfo(is_first_draw
-            , wait_sema = { wait_compute }
-            , signal_sema = {}
-            , wait_dst_stage_masks.data()
-        );
-        VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &scan_submit, VK_NULL_HANDLE));
-        VK_CHECK_RESULT(vkQueueWaitIdle(_compute.queue));
-        n_fragments = csb_curve_pixel_count[n_curves];
-        wait_compute = k_scan.semaphore;
+    auto& frame = _in_flight[_frameIndex];
+
+    takeFrameCounts(frame);
+    // nothing the compute chain reads changed since this slot's output was
+    // made in full, draw it again
+    FrameKey key = frameKey();
+    ++_frame_cache.frames;
+    if (frame.complete && frame.key == key) {
+        ++_frame_cache.cached;
+        ++_frame_cache.streak;
     }
-
-    _c.n_fragments = n_fragments;
-    
-     drawDebug();
-
-    // make intersection 1
-    int32_t stride_fragments = (n_fragments + 256) & -256;
-
-    _c.stride_fragments = stride_fragments;
-    _csb.intersection->resizeWithoutCopy(n_fragments * 2 + 2);
-    _csb.fragment_data->resizeWithoutCopy(8 * stride_fragments + 1);
-    
-	_c.make_inte_in.n_fragments = n_fragments;
-	_cub.k_make_inte_ubo->set(_c.make_inte_in, 1);
-
-	write_desc_sets = {
-		PUSH_UB_WRITE_DESC_SET(0, &_cub.k_make_inte_ubo->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(1, &_csb.intersection->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(2, &_csb.monotonic_cutpoint_cache->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(3, &_csb.curve_pixel_count->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(4, &_in_curve.curve_type->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(5, &_in_curve.curve_position_map->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(6, &_csb.transformed_pos->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(7, &_in_curve.curve_path_idx->desc.buf_info),
-		PUSH_SB_WRITE_DESC_SET(8, &_csb.path_visible->desc.buf_info),
-	};
-	k_make_inte_1.beginCmdBuffer(true)
-		->cmdPushDescSet(write_desc_sets)
-		->cmdDispatch(divup(n_curves, BLOCK_SIZE))
-		->endCmdBuffer();
-	VkSubmitInfo make_inte_1_submit = k_make_inte_1.submitInfo(is_first_draw
-		, wait_sema = { wait_compute }
-		, signal_sema = {}
-		, wait_dst_stage_masks.data()
-	);
-	VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &make_inte_1_submit, VK_NULL_HANDLE));
-    wait_compute = k_make_inte_1.semaphore;
-    
-    // gen_fragment_and_stencil_mask
-    write_desc_sets = {
-        PUSH_SB_WRITE_DESC_SET(0, &_csb.intersection->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(1, &_in_curve.curve_path_idx->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(2, &_in_curve.curve_position_map->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(3, &_in_curve.curve_type->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(4, &_csb.transformed_pos->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(5, &_csb.fragment_data->desc.buf_info),
-    };
-    k_gen_fragment.beginCmdBuffer(true)
-        ->cmdPushDescSet(write_desc_sets)
-        ->cmdPushConst(0, sizeof(uint32_t), &_compute.path_input.n_paths)
-        ->cmdPushConst(sizeof(uint32_t), sizeof(uint32_t), &_compute.curve_input.n_curves)
-        ->cmdPushConst(sizeof(uint32_t) * 2, sizeof(int32_t), &n_fragments)
-        ->cmdPushConst(sizeof(uint32_t) * 3, sizeof(int32_t), &stride_fragments)
-        ->cmdPushConst(sizeof(uint32_t) * 4, sizeof(int32_t), &_width)
-        ->cmdPushConst(sizeof(uint32_t) * 5, sizeof(int32_t), &_height)
-        ->cmdDispatch(divup(n_fragments, BLOCK_SIZE))
-        ->endCmdBuffer();
-    VkSubmitInfo gen_frag_submit = k_gen_fragment.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = {}
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &gen_frag_submit, VK_NULL_HANDLE));
-    wait_compute = k_gen_fragment.semaphore;
-    
-    // seg sort
-    VkDescriptorBufferInfo key_desc, value_desc, seg_desc;
-    key_desc.offset = 0;
-    key_desc.buffer = _csb.fragment_data->buffer();
-    key_desc.range = n_fragments * sizeof(int32_t);
-
-    value_desc.offset = stride_fragments * sizeof(int32_t);
-    value_desc.buffer = _csb.fragment_data->buffer();
-    value_desc.range = n_fragments * sizeof(int32_t);
-
-    seg_desc.offset = 3 * stride_fragments * sizeof(int32_t);
-    seg_desc.buffer = _csb.fragment_data->buffer();
-    seg_desc.range = (_in_path.n_paths + 1) * sizeof(int32_t);
-
-    write_desc_sets = {
-        PUSH_SB_WRITE_DESC_SET(0, &key_desc),
-        PUSH_SB_WRITE_DESC_SET(1, &value_desc),
-        PUSH_SB_WRITE_DESC_SET(2, &seg_desc)
-    };
-    k_seg_sort.beginCmdBuffer(true)
-        ->cmdPushDescSet(write_desc_sets)
-        ->cmdPushConst(0, sizeof(int32_t), &n_fragments)
-        ->cmdPushConst(4, sizeof(int32_t), &_in_path.n_paths)
-        ->cmdDispatch(BLOCK_SIZE, divup(_in_path.n_paths, BLOCK_SIZE))
-        ->endCmdBuffer();
-    VkSubmitInfo seg_sort_submit = k_seg_sort.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = {}
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &seg_sort_submit, VK_NULL_HANDLE));
-    wait_compute = k_seg_sort.semaphore;
-
-    //drawDebug();
-    
-
-    // shuffle fragment
-    write_desc_sets = {
-        PUSH_SB_WRITE_DESC_SET(0, &_csb.fragment_data->desc.buf_info)
-    };
-    k_shuffle_fragment.beginCmdBuffer(true)
-        ->cmdPushDescSet(write_desc_sets)
-        ->cmdPushConst(0, sizeof(int32_t), &n_fragments)
-        ->cmdPushConst(4, sizeof(int32_t), &stride_fragments)
-        ->cmdDispatch(divup(n_fragments, BLOCK_SIZE))
-        ->endCmdBuffer();
-    VkSubmitInfo shuffle_frag_submit = k_shuffle_fragment.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = {}
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &shuffle_frag_submit, VK_NULL_HANDLE));
-    wait_compute = k_shuffle_fragment.semaphore;
-
-    // exclusive scan
-    {
-        VkDescriptorBufferInfo input_desc, output_desc;
-        input_desc.offset = 3 * stride_fragments * sizeof(int32_t);
-        input_desc.buffer = _csb.fragment_data->buffer();
-        input_desc.range = n_fragments * sizeof(int32_t);
-
-        output_desc.offset = 3 * stride_fragments * sizeof(int32_t);
-        output_desc.buffer = _csb.fragment_data->buffer();
-        output_desc.range = (n_fragments + 1) * sizeof(int32_t);
-
-        write_desc_sets = {
-            PUSH_SB_WRITE_DESC_SET(0, &input_desc),
-            PUSH_SB_WRITE_DESC_SET(1, &output_desc)
-        };
-        k_scan.beginCmdBuffer(true)
-            ->cmdPushDescSet(write_desc_sets)
-            ->cmdPushConst(0, 4, &n_fragments)
-            ->cmdDispatch(1)
-            ->endCmdBuffer();
-        VkSubmitInfo scan_submit = k_scan.submitInfo(is_first_draw
-            , wait_sema = { wait_compute }
-            , signal_sema = {}
-            , wait_dst_stage_masks.data()
-        );
-        VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &scan_submit, VK_NULL_HANDLE));
-        wait_compute = k_scan.semaphore;
-        VK_CHECK_RESULT(vkQueueWaitIdle(_compute.queue));
-    }
-
-    //drawDebug();
-
-    // mark_merged_fragment_and_span
-    write_desc_sets = {
-        PUSH_SB_WRITE_DESC_SET(0, &_in_path.fill_rule->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(1, &_csb.fragment_data->desc.buf_info)
-    };
-    k_mark_merged_fragment_and_span.beginCmdBuffer(true)
-        ->cmdPushDescSet(write_desc_sets)
-        ->cmdPushConst(0, sizeof(int32_t), &n_fragments)
-        ->cmdPushConst(4, sizeof(int32_t), &stride_fragments)
-        ->cmdPushConst(8, sizeof(int32_t), &_width)
-        ->cmdPushConst(12, sizeof(int32_t), &_height)
-        ->cmdDispatch(divup(n_fragments, BLOCK_SIZE))
-        ->endCmdBuffer();
-    VkSubmitInfo mark_merge_submit = k_mark_merged_fragment_and_span.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = { }
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &mark_merge_submit, VK_NULL_HANDLE));
-    wait_compute = k_mark_merged_fragment_and_span.semaphore;
-
-    /*
-    ----------------------------------------------------------------
-    | offset  | size  |
-    | sf * 0  | nf    | position (sorted)
-    | sf * 1  | nf    | index (sorted)
-    | sf * 2  | nf    | pathid & winding_number_change
-    | sf * 3  | nf    | winding number (sorted & scaned)
-    | sf * 4  | 2*nf  | merged fragment flag, span flag
-    | sf * 5  | *     |
-    | sf * 6  | -     | -
-    | sf * 7  | -     | -
-    */
-
-    // exclusive scan
-    {
-        VkDescriptorBufferInfo input_desc, output_desc;
-        input_desc.offset = 4 * stride_fragments * sizeof(int32_t);
-        input_desc.buffer = _csb.fragment_data->buffer();
-        input_desc.range = 2 * n_fragments * sizeof(int32_t);
-
-        output_desc.offset = 6 * stride_fragments * sizeof(int32_t);
-        output_desc.buffer = input_desc.buffer;
-        output_desc.range = (2 * n_fragments + 1) * sizeof(int32_t);
-
-        write_desc_sets = {
-            PUSH_SB_WRITE_DESC_SET(0, &input_desc),
-            PUSH_SB_WRITE_DESC_SET(1, &output_desc)
-        };
-        int n = n_fragments * 2;
-        k_scan.beginCmdBuffer(true)
-            ->cmdPushDescSet(write_desc_sets)
-            ->cmdPushConst(0, 4, &n)
-            ->cmdDispatch(1)
-            ->endCmdBuffer();
-        VkSubmitInfo scan_submit = k_scan.submitInfo(is_first_draw
-            , wait_sema = { wait_compute }
-            , signal_sema = {}
-            , wait_dst_stage_masks.data()
-        );
-        VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &scan_submit, VK_NULL_HANDLE));
-        wait_compute = k_scan.semaphore;
-        VK_CHECK_RESULT(vkQueueWaitIdle(_compute.queue));
+    else {
+        if (_frame_cache.streak > 0) {
+            printf("frame cache: %u frames in a row served, %llu of %llu frames so far\n"
+                , _frame_cache.streak, static_cast<unsigned long long>(_frame_cache.cached)
+                , static_cast<unsigned long long>(_frame_cache.frames));
+            _frame_cache.streak = 0;
+        }
+        frame.key = key;
+        frame.complete = false;
+        wait_compute = recordCompute(frame);
     }
 
-    //drawDebug();
-
-    // gen_merged_fragment_and_span
-    int n_output_fragments = (*_csb.fragment_data)[stride_fragments * 6 + n_fragments];
-    int n_spans = (*_csb.fragment_data)[stride_fragments * 6 + n_fragments * 2];
-    n_spans -= n_output_fragments;
-
-    _compute.merged_fragment = n_output_fragments;
-    _compute.span = n_spans;
-    graphics.output_buf->resizeWithoutCopy(n_output_fragments + n_spans);
-    graphics.output_buf->setupBufferView(VK_FORMAT_R32G32B32A32_SINT, VK_WHOLE_SIZE);
-    VK_CHECK_RESULT(vkCreateBufferView(_device, &graphics.output_buf->desc.buf_view, nullptr, &graphics.output_buf_view));
-    write_desc_sets = {
-            PUSH_SB_WRITE_DESC_SET(0, &_csb.fragment_data->desc.buf_info),
-            PUSH_SB_WRITE_DESC_SET(1, &_in_path.fill_info->desc.buf_info),
-            PUSH_SB_WRITE_DESC_SET(2, &graphics.output_buf->desc.buf_info)
-    };
-    k_gen_merged_fragment_and_span.beginCmdBuffer(true)
-        ->cmdPushDescSet(write_desc_sets)
-        ->cmdPushConst(0, 4, &n_fragments)
-        ->cmdPushConst(4, 4, &stride_fragments)
-        ->cmdPushConst(8, 4, &_width)
-        ->cmdPushConst(12, 4, &_height)
-        ->cmdPushConst(16, 4, &n_output_fragments)
-        ->cmdPushConst(20, 4, &n_spans)
-        ->cmdDispatch(divup(n_fragments, BLOCK_SIZE))
-        ->endCmdBuffer();
-    VkSubmitInfo gen_fs_submit = k_gen_merged_fragment_and_span.submitInfo(is_first_draw
-        , wait_sema = { wait_compute }
-        , signal_sema = {}
-        , wait_dst_stage_masks.data()
-    );
-    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &gen_fs_submit, VK_NULL_HANDLE));
-    wait_compute = k_gen_merged_fragment_and_span.semaphore;
+    // edits staged from here on go with the next frame
+    _c.upload_ring->beginFrame();
 #endif
     // Submit graphics commands
     _Base::prepareFrame();
-#ifndef MOCK_DATA
+#ifdef MOCK_DATA
+    // recorded once per swap chain image in buildCommandBuffers
+    VkCommandBuffer draw_cmd = _drawCmdBuffers[_currentBuffer];
+#else
+    VkCommandBuffer draw_cmd = _frames[_frameIndex].cmdBuffer;
     VkCommandBufferBeginInfo cmdBufInfo = vk::initializer::commandBufferBeginInfo();
     cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    VK_CHECK_RESULT(vkBeginCommandBuffer(_drawCmdBuffers[_currentBuffer], &cmdBufInfo));
+    VK_CHECK_RESULT(vkBeginCommandBuffer(draw_cmd, &cmdBufInfo));
 
     // Acquire storage buffers from compute queue
-    //addComputeToGraphicsBarriers(drawCmdBuffers[i]);
+    addComputeToGraphicsBarriers(draw_cmd, frame);
 
     // Draw the particle system using the update vertex buffer
     VkRenderPassBeginInfo renderPassBeginInfo = vk::initializer::renderPassBeginInfo();    
@@ -631,43 +371,46 @@ void ScanlineVGRasterizer::drawFrame()
 
         // Set target frame buffer
     renderPassBeginInfo.framebuffer = _frameBuffers[_currentBuffer];
-    vkCmdBeginRenderPass(_drawCmdBuffers[_currentBuffer], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(draw_cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     VkViewport viewport = vk::initializer::viewport((float)_width, (float)_height, 0.0f, 1.0f);
-    vkCmdSetViewport(_drawCmdBuffers[_currentBuffer], 0, 1, &viewport);
+    vkCmdSetViewport(draw_cmd, 0, 1, &viewport);
 
     VkRect2D scissor = vk::initializer::rect2D(_width, _height, 0, 0);
-    vkCmdSetScissor(_drawCmdBuffers[_currentBuffer], 0, 1, &scissor);
+    vkCmdSetScissor(draw_cmd, 0, 1, &scissor);
 
     // Render path
-    vkCmdBindPipeline(_drawCmdBuffers[_currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.scanline);
+    vkCmdBindPipeline(draw_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelines.scanline);
 
-    write_desc_sets = {
-        vk::initializer::writeDescriptorSet(0, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 0, &graphics.output_buf_view)
+    std::vector<VkWriteDescriptorSet> write_desc_sets = {
+        vk::initializer::writeDescriptorSet(0, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 0, &frame.output_buf_view)
         //vk::initializer::writeDescriptorSet(0, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 0, &graphics.outputIndexBuffer.bufferView)
     };
-    //vkCmdBindDescriptorSets(_drawCmdBuffers[_currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
-    _vkCmdPushDescriptorSetKHR(_drawCmdBuffers[_currentBuffer]
+    //vkCmdBindDescriptorSets(draw_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipelineLayout, 0, 1, &graphics.descriptorSet, 0, NULL);
+    _vkCmdPushDescriptorSetKHR(draw_cmd
         , VK_PIPELINE_BIND_POINT_GRAPHICS
         , graphics.pipelineLayout
         , 0
         , static_cast<uint32_t>(write_desc_sets.size())
         , write_desc_sets.data());
-    vkCmdDraw(_drawCmdBuffers[_currentBuffer], graphics.output_buf->size() * 2, 1, 0, 0);
-    //vkCmdDraw(_drawCmdBuffers[_currentBuffer], outputIndex.size() * 2, 1, 0, 0);
+    // vertex count written by frame_setup
+    vkCmdDrawIndirect(draw_cmd, frame.counts->buffer(), FRAME_COUNTS_DRAW_OFFSET, 1, 0);
+    //vkCmdDraw(draw_cmd, outputIndex.size() * 2, 1, 0, 0);
 
     //drawUI(drawCmdBuffers[i]);
 
-    vkCmdEndRenderPass(_drawCmdBuffers[_currentBuffer]);
+    vkCmdEndRenderPass(draw_cmd);
 
-    // release the storage buffers to the compute queue
-    //addGraphicsToComputeBarriers(drawCmdBuffers[i]);
+    // no release back to the compute queue: the slot's next compute
+    // overwrites output_buf and counts without reading them, after the
+    // slot fence, so their contents may be left undefined
 
-    VK_CHECK_RESULT(vkEndCommandBuffer(_drawCmdBuffers[_currentBuffer]));
+    VK_CHECK_RESULT(vkEndCommandBuffer(draw_cmd));
 #endif
 
+    // the compute results are read from the indirect draw arguments on
     std::array<VkPipelineStageFlags,2> waitDstStageMask = {
-        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
     };
 #ifdef MOCK_DATA
     std::array<VkSemaphore, 1> waitSemaphores = {
@@ -682,43 +425,453 @@ void ScanlineVGRasterizer::drawFrame()
     std::array<VkSemaphore, 1> signalSemaphores = {
         _semaphores.renderComplete
     };
+#ifdef MOCK_DATA
     submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+#else
+    // a frame served from the cache submitted no compute
+    submitInfo.waitSemaphoreCount = wait_compute != VK_NULL_HANDLE ? 2 : 1;
+#endif
     submitInfo.pWaitSemaphores = waitSemaphores.data();
     submitInfo.pWaitDstStageMask = waitDstStageMask.data();
 
     submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
     submitInfo.pSignalSemaphores = signalSemaphores.data();
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &_drawCmdBuffers[_currentBuffer];
-    VK_CHECK_RESULT(vkQueueSubmit(_presentQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    submitInfo.pCommandBuffers = &draw_cmd;
+    VK_CHECK_RESULT(vkQueueSubmit(_presentQueue, 1, &submitInfo, _Base::frameFence()));
     _Base::submitFrame();
     
 }
 
-void ScanlineVGRasterizer::drawDebug()
+ScanlineVGRasterizer::FrameKey ScanlineVGRasterizer::frameKey() const
 {
-    auto save_data = [&](const std::string& kv_file, int ind) {
-        std::ofstream fin;
-        fin.open(kv_file);
-        if (!fin.is_open()) {
-            std::runtime_error(kv_file + " open failed");
-        }
-        int* ptr = _compute.storage_buffers.fragment_data->cptr();
-        for (int i = 0; i <= _compute.n_fragments; ++i) {
-            switch (ind) {
-            case 1:
-                fin << ptr[i] << "," << ptr[_compute.stride_fragments + i] << "," << ptr[_compute.stride_fragments * 3 + i] << "\n";
-                break;
-            case 2:
-                fin << ptr[_compute.stride_fragments * 3 + i] << "\n";
-                break;
-            }
-            //printf("%d,%d\n", ptr[0 * _compute.stride_fragments + i], ptr[_compute.stride_fragments + i]);
+    auto& t = _compute.trans_pos_in;
+    const glm::vec4 mvp[4] = { t.m0, t.m1, t.m2, t.m3 };
+    return { fnv1a(mvp, sizeof(mvp)), _scene_generation, _width, _height };
+}
+
+/*
+* Size the fragment and output buffers from what the frame that last used
+* this slot needed, a frame that ran past them was drawn clipped and is
+* drawn in full from here on
+*/
+void ScanlineVGRasterizer::takeFrameCounts(InFlightFrame& frame)
+{
+    auto& _c = _compute;
+    if (!frame.counts_pending) {
+        return;
+    }
+    ivec4 used = _c.readback->get<ivec4>(frame.counts_slot);
+    ivec4 needed = _c.readback->get<ivec4>(frame.needed_slot);
+    frame.counts_pending = false;
+    frame.complete = needed.z == 0;
+    _c.n_fragments = used.x;
+    _c.merged_fragment = used.y;
+    _c.span = used.z;
+
+    int32_t max_fragments = fitCapacity(needed.x, _c.max_fragments);
+    int32_t max_output = fitCapacity(needed.y, _c.max_output);
+    if (needed.z != 0) {
+        printf("frame counts overflowed: %d fragments (room for %d), %d outputs (room for %d), growing\n"
+            , needed.x, _c.max_fragments, needed.y, _c.max_output);
+    }
+    _c.max_fragments = max_fragments;
+    _c.max_output = max_output;
+}
+
+/*
+* Record and submit the compute chain of 'frame' into its output buffer,
+* returns the semaphore the draw waits on
+*/
+VkSemaphore ScanlineVGRasterizer::recordCompute(InFlightFrame& frame)
+{
+    auto& k_scan = *(_kernal.scan);
+
+    auto& k_transform_pos = *(_kernal.transform_pos);
+    auto& k_make_inte_0 = *(_kernal.make_intersection_0);
+    auto& k_make_inte_1 = *(_kernal.make_intersection_1);
+    auto& k_gen_fragment = *(_kernal.gen_fragment);
+    auto& k_seg_sort = *(_kernal.seg_sort);
+    auto& k_shuffle_fragment = *(_kernal.shuffle_fragment);
+    auto& k_mark_merged_fragment_and_span = *(_kernal.mark_merged_fragment_and_span);
+    auto& k_gen_merged_fragment_and_span = *(_kernal.gen_merged_fragment_and_span);
+    auto& k_frame_setup = *(_kernal.frame_setup);
+
+    std::vector<VkPipelineStageFlags> wait_dst_stage_masks = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+
+    auto& _c = _compute;
+    auto& _csb = _compute.storage_buffers;
+    auto& _in_geom = _c.geometry_input;
+    auto& _in_curve = _c.curve_input;
+    auto& _in_path = _c.path_input;
+    auto& ring = *_c.upload_ring;
+
+    int32_t max_fragments = _c.max_fragments;
+    int32_t max_output = _c.max_output;
+    int32_t block_size = _kernal_config.block_size;
+    // the sort segments of all paths live in the stride too
+    int32_t stride_fragments = ((std::max)(max_fragments, static_cast<int32_t>(_in_path.n_paths)) + 256) & -256;
+    _c.stride_fragments = stride_fragments;
+
+    // re-plan transient memory, the buffers move on their next resize
+    uint32_t transient_generation = _c.transient->generation();
+    _c.transient->beginFrame();
+    if (_c.transient->generation() != transient_generation) {
+        printf("transient buffers: %.1f MiB aliased, %.1f MiB without aliasing\n"
+            , _c.transient->size() / 1048576.0, _c.transient->unaliasedSize() / 1048576.0);
+        // the buffers that follow the fragment count, sizes as of the last frame
+        const std::pair<const char*, vulkan::BufferStats> buffer_stats[] = {
+            { "intersection", _csb.intersection->stats() },
+            { "fragment_data", _csb.fragment_data->stats() },
+            { "fragment_scan", _csb.fragment_scan->stats() },
+            { "output", frame.output_buf->stats() }
+        };
+        for (const auto& s : buffer_stats) {
+            printf("  %s: %.1f of %.1f MiB, high water %.1f MiB, %u grows, %u shrinks\n"
+                , s.first, s.second.size / 1048576.0, s.second.capacity / 1048576.0
+                , s.second.high_water / 1048576.0, s.second.grows, s.second.shrinks);
         }
-        fin.close();
+    }
+    _csb.transformed_pos->resizeWithoutCopy(_in_curve.n_points);
+    _csb.path_visible->resizeWithoutCopy(_in_path.n_paths);
+    _csb.curve_pixel_count->resizeWithoutCopy(_in_curve.n_curves + 1);
+    _csb.monotonic_cutpoint_cache->resizeWithoutCopy(static_cast<VkDeviceSize>(_in_curve.n_curves) * 5);
+    _csb.intersection->resizeWithoutCopy(static_cast<VkDeviceSize>(max_fragments) * 2 + 2);
+    _csb.fragment_data->resizeWithoutCopy(static_cast<VkDeviceSize>(stride_fragments) * 6);
+    _csb.fragment_scan->resizeWithoutCopy(static_cast<VkDeviceSize>(max_fragments) * 2 + 1);
+    frame.output_buf->resizeWithoutCopy(max_output);
+    if (frame.output_buf->buffer() != frame.output_buf_view_target) {
+        // the frame that last drew through the view is done
+        vkDestroyBufferView(_device, frame.output_buf_view, nullptr);
+        frame.output_buf->setupBufferView(VK_FORMAT_R32G32B32A32_SINT, VK_WHOLE_SIZE);
+        VK_CHECK_RESULT(vkCreateBufferView(_device, &frame.output_buf->desc.buf_view, nullptr, &frame.output_buf_view));
+        frame.output_buf_view_target = frame.output_buf->buffer();
+    }
+
+    _c.make_inte_in.max_fragments = max_fragments;
+    VkDescriptorBufferInfo trans_pos_ubo = ring.push(_c.trans_pos_in);
+    VkDescriptorBufferInfo make_inte_ubo = ring.push(_c.make_inte_in);
+
+    /*
+    * The whole chain is one submit without a host round trip: frame_setup
+    * turns the scanned counts into frame_counts, the kernels sized by the
+    * fragment count launch from its dispatch arguments and the draw from
+    * its draw arguments. The counts are read back at the end of the chain
+    * and picked up when the frame slot comes around again.
+    *
+    * Passes declare what their bindings read and write, the graph orders
+    * them and puts the barriers in.
+    */
+    auto& batch = *frame.batch;
+    auto& counts = *frame.counts;
+    auto& graph = *frame.graph;
+    VkBuffer counts_buf = counts.buffer();
+    std::vector<VkSemaphore> wait_sema = {};
+    std::vector<VkSemaphore> signal_sema = {};
+    int32_t no_count_scale = 0;
+    uint32_t n_curves = _in_curve.n_curves;
+    VkDescriptorBufferInfo fragment_data = _csb.fragment_data->desc.buf_info;
+    // plane 'k' of fragment_data, 'n' ints from the start of it
+    auto plane = [&](VkDeviceSize k, VkDeviceSize n) {
+        VkDescriptorBufferInfo info = fragment_data;
+        info.offset = k * stride_fragments * sizeof(int32_t);
+        info.range = n * sizeof(int32_t);
+        return info;
+    };
+
+    if (graph.collectTimings() && _c.dump_schedule) {
+        graph.dump();
+        _c.dump_schedule = false;
+    }
+    graph.reset();
+
+    // transform position
+    graph.addPass("transform_pos", k_transform_pos)
+        ->uniform(0, trans_pos_ubo)
+        ->read(1, _in_geom.position->desc.buf_info)
+        ->read(2, _in_curve.position_path_idx->desc.buf_info)
+        ->write(3, _csb.transformed_pos->desc.buf_info)
+        ->readWrite(4, _csb.path_visible->desc.buf_info)
+        ->read(5, _in_path.transform->desc.buf_info)
+        ->read(6, _in_path.geometry->desc.buf_info)
+        ->read(7, _in_geom.point_begin->desc.buf_info)
+        ->read(8, _in_path.point_begin->desc.buf_info)
+        ->dispatch(divup(_in_curve.n_points, block_size));
+
+    // make intersection 0
+    graph.addPass("make_intersection_0", k_make_inte_0)
+        ->uniform(0, make_inte_ubo)
+        ->read(1, _in_curve.curve_type->desc.buf_info)
+        ->read(2, _in_curve.curve_position_map->desc.buf_info)
+        ->read(3, _csb.transformed_pos->desc.buf_info)
+        ->read(4, _in_curve.curve_path_idx->desc.buf_info)
+        ->read(5, _csb.path_visible->desc.buf_info)
+        ->write(6, _csb.monotonic_cutpoint_cache->desc.buf_info)
+        ->write(7, _csb.curve_pixel_count->desc.buf_info)
+        ->read(8, _in_curve.curve_arc_w->desc.buf_info)
+        ->dispatch(divup(n_curves, block_size));
+
+    // exclusive scan
+    graph.addPass("scan_curve_pixel_count", k_scan)
+        ->read(0, _csb.curve_pixel_count->desc.buf_info)
+        ->readWrite(1, _csb.curve_pixel_count->desc.buf_info)
+        ->read(2, counts.desc.buf_info)
+        ->pushConst(0, 4, &n_curves)
+        ->pushConst(4, 4, &no_count_scale)
+        ->dispatch(1);
+
+    // n_fragments and the launch arguments of the kernels over them
+    int32_t setup_stage = SETUP_FRAGMENTS;
+    graph.addPass("frame_setup_fragments", k_frame_setup)
+        ->read(0, _csb.curve_pixel_count->desc.buf_info)
+        ->readWrite(1, counts.desc.buf_info)
+        ->pushConst(0, 4, &setup_stage)
+        ->pushConst(4, 4, &max_fragments)
+        ->pushConst(8, 4, &max_output)
+        ->pushConst(12, 4, &n_curves)
+        ->dispatch(1);
+
+    // make intersection 1
+    graph.addPass("make_intersection_1", k_make_inte_1)
+        ->uniform(0, make_inte_ubo)
+        ->write(1, _csb.intersection->desc.buf_info)
+        ->read(2, _csb.monotonic_cutpoint_cache->desc.buf_info)
+        ->read(3, _csb.curve_pixel_count->desc.buf_info)
+        ->read(4, _in_curve.curve_type->desc.buf_info)
+        ->read(5, _in_curve.curve_position_map->desc.buf_info)
+        ->read(6, _csb.transformed_pos->desc.buf_info)
+        ->read(7, _in_curve.curve_path_idx->desc.buf_info)
+        ->read(8, _csb.path_visible->desc.buf_info)
+        ->read(9, _in_curve.curve_arc_w->desc.buf_info)
+        ->dispatch(divup(n_curves, block_size));
+
+    // gen_fragment_and_stencil_mask
+    graph.addPass("gen_fragment", k_gen_fragment)
+        ->read(0, _csb.intersection->desc.buf_info)
+        ->read(1, _in_curve.curve_path_idx->desc.buf_info)
+        ->read(2, _in_curve.curve_position_map->desc.buf_info)
+        ->read(3, _in_curve.curve_type->desc.buf_info)
+        ->read(4, _csb.transformed_pos->desc.buf_info)
+        ->write(5, fragment_data)
+        ->read(6, _in_curve.curve_arc_w->desc.buf_info)
+        ->read(7, counts.desc.buf_info)
+        ->pushConst(0, sizeof(uint32_t), &_in_path.n_paths)
+        ->pushConst(sizeof(uint32_t), sizeof(uint32_t), &n_curves)
+        ->pushConst(sizeof(uint32_t) * 3, sizeof(int32_t), &stride_fragments)
+        ->pushConst(sizeof(uint32_t) * 4, sizeof(int32_t), &_width)
+        ->pushConst(sizeof(uint32_t) * 5, sizeof(int32_t), &_height)
+        ->dispatchIndirect(counts_buf, FRAME_COUNTS_DISPATCH_OFFSET);
+
+    // seg sort: keys, values and the segment starts of the paths
+    VkDescriptorBufferInfo seg_desc = plane(3, _in_path.n_paths + 1);
+    graph.addPass("seg_sort", k_seg_sort)
+        ->readWrite(0, plane(0, max_fragments))
+        ->readWrite(1, plane(1, max_fragments))
+        ->read(2, seg_desc)
+        ->pushConst(0, sizeof(int32_t), &max_fragments)
+        ->pushConst(4, sizeof(int32_t), &_in_path.n_paths)
+        ->dispatch(block_size, divup(_in_path.n_paths, block_size));
+
+    // shuffle fragment
+    graph.addPass("shuffle_fragment", k_shuffle_fragment)
+        ->readWrite(0, fragment_data)
+        ->read(1, counts.desc.buf_info)
+        ->pushConst(4, sizeof(int32_t), &stride_fragments)
+        ->dispatchIndirect(counts_buf, FRAME_COUNTS_DISPATCH_OFFSET);
+
+    // exclusive scan
+    int32_t count_scale = 1;
+    graph.addPass("scan_winding_number", k_scan)
+        ->read(0, plane(3, max_fragments))
+        ->readWrite(1, plane(3, max_fragments + 1))
+        ->read(2, counts.desc.buf_info)
+        ->pushConst(4, 4, &count_scale)
+        ->dispatch(1);
+
+    // mark_merged_fragment_and_span
+    graph.addPass("mark_merged_fragment_and_span", k_mark_merged_fragment_and_span)
+        ->read(0, _in_path.fill_rule->desc.buf_info)
+        ->readWrite(1, fragment_data)
+        ->read(2, counts.desc.buf_info)
+        ->pushConst(4, sizeof(int32_t), &stride_fragments)
+        ->pushConst(8, sizeof(int32_t), &_width)
+        ->pushConst(12, sizeof(int32_t), &_height)
+        ->dispatchIndirect(counts_buf, FRAME_COUNTS_DISPATCH_OFFSET);
+
+    /*
+    ----------------------------------------------------------------
+    | offset  | size  |
+    | sf * 0  | nf    | position (sorted)
+    | sf * 1  | nf    | index (sorted)
+    | sf * 2  | nf    | pathid & winding_number_change
+    | sf * 3  | nf    | winding number (sorted & scaned)
+    | sf * 4  | 2*nf  | merged fragment flag, span flag
+    | sf * 5  | *     |
+    ----------------------------------------------------------------
+    The scan of the flags goes to fragment_scan, which lives from here
+    on only and shares memory with intersection.
+    */
+
+    // exclusive scan
+    count_scale = 2;
+    graph.addPass("scan_merged_flags", k_scan)
+        ->read(0, plane(4, 2 * max_fragments))
+        ->write(1, _csb.fragment_scan->desc.buf_info)
+        ->read(2, counts.desc.buf_info)
+        ->pushConst(4, 4, &count_scale)
+        ->dispatch(1);
+
+    // output counts and the draw arguments
+    setup_stage = SETUP_OUTPUT;
+    int32_t scan_offset = 0;
+    graph.addPass("frame_setup_output", k_frame_setup)
+        ->read(0, _csb.fragment_scan->desc.buf_info)
+        ->readWrite(1, counts.desc.buf_info)
+        ->pushConst(0, 4, &setup_stage)
+        ->pushConst(4, 4, &max_fragments)
+        ->pushConst(8, 4, &max_output)
+        ->pushConst(12, 4, &scan_offset)
+        ->dispatch(1);
+
+    // gen_merged_fragment_and_span
+    graph.addPass("gen_merged_fragment_and_span", k_gen_merged_fragment_and_span)
+        ->read(0, fragment_data)
+        ->read(1, _in_path.fill_info->desc.buf_info)
+        ->write(2, frame.output_buf->desc.buf_info)
+        ->read(3, counts.desc.buf_info)
+        ->read(4, _csb.fragment_scan->desc.buf_info)
+        ->pushConst(4, 4, &stride_fragments)
+        ->pushConst(8, 4, &_width)
+        ->pushConst(12, 4, &_height)
+        ->pushConst(16, 4, &max_output)
+        ->dispatchIndirect(counts_buf, FRAME_COUNTS_DISPATCH_OFFSET);
+
+    graph.compile();
+    // lifetimes of the transient buffers for the next plan, the passes
+    // are the same every frame
+    auto& ids = _c.transient_ids;
+    planTransient(graph, _csb.transformed_pos->buffer(), ids.transformed_pos);
+    planTransient(graph, _csb.path_visible->buffer(), ids.path_visible);
+    planTransient(graph, _csb.curve_pixel_count->buffer(), ids.curve_pixel_count);
+    planTransient(graph, _csb.monotonic_cutpoint_cache->buffer(), ids.monotonic_cutpoint_cache);
+    planTransient(graph, _csb.intersection->buffer(), ids.intersection);
+    planTransient(graph, _csb.fragment_data->buffer(), ids.fragment_data);
+    planTransient(graph, _csb.fragment_scan->buffer(), ids.fragment_scan);
+
+    VkCommandBuffer cmd = batch.begin();
+    // the intermediates are shared with the frame before, still in flight
+    batch.cmdQueueBarrier();
+    ring.cmdFlushCopies(cmd);
+    if (_c.expand_pending) {
+        cmdExpandInstances(cmd);
+        batch.cmdBarrier({ _in_curve.position_path_idx->buffer(), _in_curve.curve_position_map->buffer()
+            , _in_curve.curve_type->buffer(), _in_curve.curve_path_idx->buffer(), _in_curve.curve_arc_w->buffer() });
+        _c.expand_pending = false;
+    }
+    graph.record(cmd);
+
+    // sizes for the slot's next frame, see frame_setup.comp for the layout;
+    // the frame fence covers the copies, no readback fence
+    frame.counts_slot = _c.readback->cmdRead(cmd, frame.counts, 0);
+    frame.needed_slot = _c.readback->cmdRead(cmd, frame.counts, 1);
+    frame.counts_pending = true;
+    if (_c.async) {
+        // frame N+1's compute overlaps the draw of frame N on the other family
+        batch.cmdRelease({ frame.output_buf->buffer(), counts_buf }
+            , _vulkanDevice->queueFamilyIndices.compute, _vulkanDevice->queueFamilyIndices.graphics);
+        frame.acquire_pending = true;
+    }
+    batch.end();
+    VkSubmitInfo compute_submit = batch.submitInfo(wait_sema = {}
+        , signal_sema = {}
+        , wait_dst_stage_masks.data()
+    );
+    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &compute_submit, VK_NULL_HANDLE));
+    return batch.semaphore;
+}
+
+void ScanlineVGRasterizer::planTransient(const ComputeGraph& graph, VkBuffer buffer, uint32_t id)
+{
+    uint32_t first, last;
+    if (graph.lifetime(buffer, first, last)) {
+        _compute.transient->setPasses(id, first, last);
+    }
+}
+
+/*
+* Expand the instances of the scene loadVG uploaded into the per curve
+* and per point arrays, ahead of the first frame that draws it. Curve
+* types stay packed, a thread writes the whole word of 4 curves
+*/
+void ScanlineVGRasterizer::cmdExpandInstances(VkCommandBuffer cmd)
+{
+    auto& _in_geom = _compute.geometry_input;
+    auto& _in_curve = _compute.curve_input;
+    auto& _in_path = _compute.path_input;
+
+    uint32_t paths_are_geometries = _in_curve.paths_are_geometries ? 1 : 0;
+    std::vector<VkWriteDescriptorSet> wds_expand = {
+        PUSH_SB_WRITE_DESC_SET(0, &_in_geom.point_begin->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(1, &_in_geom.curve_begin->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(2, &_in_geom.curve_position_map->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(3, &_in_geom.curve_type->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(4, &_in_geom.curve_arc_w->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(5, &_in_path.geometry->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(6, &_in_path.point_begin->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(7, &_in_path.curve_begin->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(8, &_in_curve.position_path_idx->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(9, &_in_curve.curve_position_map->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(10, &_in_curve.curve_type->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(11, &_in_curve.curve_path_idx->desc.buf_info),
+        PUSH_SB_WRITE_DESC_SET(12, &_in_curve.curve_arc_w->desc.buf_info)
     };
-    //save_data("kv.out", 1);
-    //save_data("segments.out", 2);
+    _kernal.expand_instances->record(cmd)
+        ->cmdPushDescSet(wds_expand)
+        ->cmdPushConst(0, sizeof(uint32_t), &_in_path.n_paths)
+        ->cmdPushConst(sizeof(uint32_t), sizeof(uint32_t), &_in_curve.n_curves)
+        ->cmdPushConst(sizeof(uint32_t) * 2, sizeof(uint32_t), &_in_curve.n_points)
+        ->cmdPushConst(sizeof(uint32_t) * 3, sizeof(uint32_t), &paths_are_geometries)
+        ->cmdDispatch(divup(divup(_in_curve.n_curves, 4) + _in_curve.n_points, _kernal_config.block_size));
+}
+
+void ScanlineVGRasterizer::dumpComputeSchedule()
+{
+    _compute.dump_schedule = true;
+}
+
+/*
+* Acquire output_buf and the draw arguments the compute queue released,
+* once per compute, frames served from the cache already own them
+*/
+void ScanlineVGRasterizer::addComputeToGraphicsBarriers(VkCommandBuffer cmd, InFlightFrame& frame)
+{
+    if (!frame.acquire_pending) {
+        return;
+    }
+    frame.acquire_pending = false;
+
+    std::array<VkBuffer, 2> buffers = { frame.output_buf->buffer(), frame.counts->buffer() };
+    std::array<VkBufferMemoryBarrier, 2> barriers;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        barriers[i] = vk::initializer::bufferMemoryBarrier();
+        barriers[i].srcAccessMask = 0;
+        barriers[i].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        barriers[i].srcQueueFamilyIndex = _vulkanDevice->queueFamilyIndices.compute;
+        barriers[i].dstQueueFamilyIndex = _vulkanDevice->queueFamilyIndices.graphics;
+        barriers[i].buffer = buffers[i];
+        barriers[i].offset = 0;
+        barriers[i].size = VK_WHOLE_SIZE;
+    }
+    // chained to the compute semaphore wait at the draw indirect stage
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+        , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        , 0, 0, nullptr
+        , static_cast<uint32_t>(barriers.size()), barriers.data()
+        , 0, nullptr);
+}
+
+void ScanlineVGRasterizer::drawDebug()
+{
     // for point debug
     //vec2* ptr = _compute.storage_buffers.transformed_pos->cptr();
     //printf("-------------------- begin --------------------\n");
@@ -818,13 +971,18 @@ void ScanlineVGRasterizer::prepareTexelBuffers()
 #endif
     // output merged fragment
     VkQueue queue = _presentQueue;
+    uint32_t queue_family = _vulkanDevice->queueFamilyIndices.graphics;
     VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
         | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
         | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT
         | VK_BUFFER_USAGE_TRANSFER_DST_BIT
         | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
     VkMemoryPropertyFlags memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    graphics.output_buf = GPU_VULKAN_BUFFER(ivec4);
+    _in_flight.resize(settings.framesInFlight);
+    for (auto& frame : _in_flight) {
+        frame.output_buf = GPU_VULKAN_BUFFER(ivec4);
+        frame.output_buf->setPolicy(TRANSIENT_BUFFER_POLICY);
+    }
 }
 
 void ScanlineVGRasterizer::setupDescriptorPool()
@@ -952,6 +1110,17 @@ void ScanlineVGRasterizer::prepareCompute()
     cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     VK_CHECK_RESULT(vkCreateCommandPool(_device, &cmdPoolInfo, nullptr, &_compute.cmd_pool));
 
+    // scalar results drawFrame sizes its buffers with
+    _compute.readback = std::make_shared<vulkan::ReadbackRing>(_vulkanDevice, READBACK_SLOTS);
+    // passes are timed when the compute queue writes timestamps
+    uint32_t timestamp_bits = _vulkanDevice->queueFamilyProperties[_vulkanDevice->queueFamilyIndices.compute].timestampValidBits;
+    float timestamp_period = timestamp_bits != 0 ? _vulkanDevice->properties.limits.timestampPeriod : 0.0f;
+    for (auto& frame : _in_flight) {
+        frame.batch = std::make_shared<ComputeBatch>(_device, _compute.cmd_pool);
+        frame.graph = std::make_shared<ComputeGraph>(_device, timestamp_period);
+    }
+    _compute.dump_schedule = true;
+
 
     // CPU-GPU synchronization
     //VkFenceCreateInfo fenceInfo = vk::initializer::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
@@ -959,47 +1128,47 @@ void ScanlineVGRasterizer::prepareCompute()
     //VK_CHECK_RESULT(vkCreateFence(_device, &fenceInfo, VK_NULL_HANDLE, &_compute.fence));
 
     prepareCommonComputeKernal();
-    auto& _c = _compute;
-    auto& _cin_curve = _compute.curve_input;
-    auto& _csb = _compute.storage_buffers;
-    auto& _cub = _compute.uniform_buffers;
-
     auto& _k = _kernal;
 
-    std::vector<VkWriteDescriptorSet> write_desc_sets;
-    auto wds2dt = [](std::vector<VkWriteDescriptorSet> &write_desc_sets) -> std::vector<VkDescriptorType> {
-        std::vector<VkDescriptorType> desc_type;
-        desc_type.reserve(write_desc_sets.size());
-        for (auto& wds : write_desc_sets) {
-            desc_type.push_back(wds.descriptorType);
-        }
-        return desc_type;
+    // expand instances, recorded by recordCompute after each loadVG
+    std::vector<VkDescriptorType> dt_expand(13, DESC_TYPE_SB);
+    std::vector<VkPushConstantRange> expand_pcr{
+        vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t) * 4, 0)
     };
+    KernalSpecialization expand_spec = kernalSpecialization(_kernal_config.block_size);
+    _k.expand_instances = COMPUTE_KERNAL(dt_expand, COMPUTE_SPV_DIR + "expand_instances.comp.spv", &expand_pcr, expand_spec.info());
 
-    // transform position
-    std::vector<VkWriteDescriptorSet> wds_transform = {
-        PUSH_UB_WRITE_DESC_SET(0, &_cub.k_trans_pos_ubo->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(1, &_cin_curve.position->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(2, &_cin_curve.position_path_idx->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(3, &_csb.transformed_pos->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(4, &_csb.path_visible->desc.buf_info)
+    prepareScanlineKernal();
+}
+
+/*
+* The kernals recorded every frame, specialized with _kernal_config;
+* called again when the configuration changes
+*/
+void ScanlineVGRasterizer::prepareScanlineKernal()
+{
+    auto& _k = _kernal;
+    KernalSpecialization spec = kernalSpecialization(_kernal_config.block_size);
+
+    // transform position, recorded per frame behind the upload ring copies
+    std::vector<VkDescriptorType> dt_transform{
+        DESC_TYPE_UB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB
     };
-    _k.transform_pos = COMPUTE_KERNAL(wds2dt(wds_transform), COMPUTE_SPV_DIR + "transform_pos.comp.spv", nullptr);
-    _k.transform_pos->buildCmdBuffer(divup(_compute.curve_input.n_points, BLOCK_SIZE), wds_transform);
+    _k.transform_pos = COMPUTE_KERNAL(dt_transform, COMPUTE_SPV_DIR + "transform_pos.comp.spv", nullptr, spec.info());
 
     // make intersection 0
-    std::vector<VkWriteDescriptorSet> wds_make_int_0 {
-        PUSH_UB_WRITE_DESC_SET(0, &_cub.k_make_inte_ubo->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(1, &_cin_curve.curve_type->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(2, &_cin_curve.curve_position_map->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(3, &_csb.transformed_pos->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(4, &_cin_curve.curve_path_idx->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(5, &_csb.path_visible->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(6, &_csb.monotonic_cutpoint_cache->desc.buf_info),
-        PUSH_SB_WRITE_DESC_SET(7, &_csb.curve_pixel_count->desc.buf_info)
+    std::vector<VkDescriptorType> dt_make_int_0{
+        DESC_TYPE_UB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB,DESC_TYPE_SB
     };
-    _k.make_intersection_0 = COMPUTE_KERNAL(wds2dt(wds_make_int_0), COMPUTE_SPV_DIR + "make_intersection_0.comp.spv", nullptr);
-    _k.make_intersection_0->buildCmdBuffer(divup(_compute.curve_input.n_curves, BLOCK_SIZE), wds_make_int_0);
+    _k.make_intersection_0 = COMPUTE_KERNAL(dt_make_int_0, COMPUTE_SPV_DIR + "make_intersection_0.comp.spv", nullptr, spec.info());
 
     // make intersection 1
     std::vector<VkDescriptorType> dt_make_int_1{
@@ -1007,13 +1176,15 @@ void ScanlineVGRasterizer::prepareCompute()
         DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB,
-        DESC_TYPE_SB,DESC_TYPE_SB
+        DESC_TYPE_SB,DESC_TYPE_SB,
+        DESC_TYPE_SB
     };
 
-    _k.make_intersection_1 = COMPUTE_KERNAL(dt_make_int_1, COMPUTE_SPV_DIR + "make_intersection_1.comp.spv", nullptr);
+    _k.make_intersection_1 = COMPUTE_KERNAL(dt_make_int_1, COMPUTE_SPV_DIR + "make_intersection_1.comp.spv", nullptr, spec.info());
     
     // generate fragments
     std::vector<VkDescriptorType> dt_gen_frag{
+        DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB
@@ -1021,7 +1192,7 @@ void ScanlineVGRasterizer::prepareCompute()
     std::vector<VkPushConstantRange> gen_frag_pcr{
         vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 6, 0)
     };
-    _k.gen_fragment = COMPUTE_KERNAL(dt_gen_frag, COMPUTE_SPV_DIR + "gen_fragment.comp.spv", &gen_frag_pcr);
+    _k.gen_fragment = COMPUTE_KERNAL(dt_gen_frag, COMPUTE_SPV_DIR + "gen_fragment.comp.spv", &gen_frag_pcr, spec.info());
 
     // shuffle fragment
     std::vector<VkDescriptorType> dt_shuffle_frag{
@@ -1030,28 +1201,37 @@ void ScanlineVGRasterizer::prepareCompute()
     std::vector<VkPushConstantRange> shuffle_frag_pcr{
         vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 2, 0)
     };
-    _k.shuffle_fragment = COMPUTE_KERNAL(dt_shuffle_frag, COMPUTE_SPV_DIR + "shuffle_fragment.comp.spv", &shuffle_frag_pcr);
+    _k.shuffle_fragment = COMPUTE_KERNAL(dt_shuffle_frag, COMPUTE_SPV_DIR + "shuffle_fragment.comp.spv", &shuffle_frag_pcr, spec.info());
 
     // mark merged fragment and span
     std::vector<VkDescriptorType> dt_mark_merge{
         DESC_TYPE_SB,DESC_TYPE_SB,
-        DESC_TYPE_SB,DESC_TYPE_SB
+        DESC_TYPE_SB
     };
     std::vector<VkPushConstantRange> mark_merge_pcr{
         vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 4, 0)
     };
-    _k.mark_merged_fragment_and_span = COMPUTE_KERNAL(dt_mark_merge, COMPUTE_SPV_DIR + "mark_merged_fragment_and_span.comp.spv", &mark_merge_pcr);
+    _k.mark_merged_fragment_and_span = COMPUTE_KERNAL(dt_mark_merge, COMPUTE_SPV_DIR + "mark_merged_fragment_and_span.comp.spv", &mark_merge_pcr, spec.info());
 
     //gen_merged_fragment_and_span
     std::vector<VkDescriptorType> dt_gen_fs{
+        DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB,DESC_TYPE_SB,
         DESC_TYPE_SB
     };
     std::vector<VkPushConstantRange> gen_fs_pcr{
         vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 6, 0)
     };
-    _k.gen_merged_fragment_and_span = COMPUTE_KERNAL(dt_gen_fs, COMPUTE_SPV_DIR + "gen_merged_fragment_and_span.comp.spv", &gen_fs_pcr);
+    _k.gen_merged_fragment_and_span = COMPUTE_KERNAL(dt_gen_fs, COMPUTE_SPV_DIR + "gen_merged_fragment_and_span.comp.spv", &gen_fs_pcr, spec.info());
 
+    // frame setup, counts to indirect launch arguments
+    std::vector<VkDescriptorType> dt_frame_setup{
+        DESC_TYPE_SB,DESC_TYPE_SB
+    };
+    std::vector<VkPushConstantRange> frame_setup_pcr{
+        vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 4, 0)
+    };
+    _k.frame_setup = COMPUTE_KERNAL(dt_frame_setup, COMPUTE_SPV_DIR + "frame_setup.comp.spv", &frame_setup_pcr, spec.info());
 }
 
 void ScanlineVGRasterizer::buildCommandBuffers()
@@ -1112,11 +1292,11 @@ void ScanlineVGRasterizer::prepareComputeBuffers()
 {   
     auto& _c = _compute;
     auto& _csb = _c.storage_buffers;
-    auto& _cub = _c.uniform_buffers;
     auto& _in_curve = _c.curve_input;
     auto& _in_path = _c.path_input;
     
     VkQueue queue = _c.queue;
+    uint32_t queue_family = _vulkanDevice->queueFamilyIndices.compute;
     VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
         | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
         | VK_BUFFER_USAGE_TRANSFER_DST_BIT
@@ -1131,6 +1311,30 @@ void ScanlineVGRasterizer::prepareComputeBuffers()
     //_csb.monotonic_n_cuts_cache = GPU_VULKAN_BUFFER(uint32_t);
     _csb.intersection = GPU_VULKAN_BUFFER(float);
     _csb.fragment_data = GPU_VULKAN_BUFFER(int32_t);
+    _csb.fragment_scan = GPU_VULKAN_BUFFER(int32_t);
+    _csb.intersection->setPolicy(TRANSIENT_BUFFER_POLICY);
+    _csb.fragment_data->setPolicy(TRANSIENT_BUFFER_POLICY);
+    _csb.fragment_scan->setPolicy(TRANSIENT_BUFFER_POLICY);
+
+    // intermediates share memory where their lifetimes in the frame don't overlap
+    _c.transient = std::make_shared<vk::TransientHeap>(_vulkanDevice.get(), memory_property_flags);
+    auto& heap = *_c.transient;
+    // nothing aliases until the compute graph gave the lifetimes
+    auto& ids = _c.transient_ids;
+    ids.transformed_pos = heap.add(0, UINT32_MAX);
+    ids.path_visible = heap.add(0, UINT32_MAX);
+    ids.curve_pixel_count = heap.add(0, UINT32_MAX);
+    ids.monotonic_cutpoint_cache = heap.add(0, UINT32_MAX);
+    ids.intersection = heap.add(0, UINT32_MAX);
+    ids.fragment_data = heap.add(0, UINT32_MAX);
+    ids.fragment_scan = heap.add(0, UINT32_MAX);
+    _csb.transformed_pos->setTransient(_c.transient, ids.transformed_pos);
+    _csb.path_visible->setTransient(_c.transient, ids.path_visible);
+    _csb.curve_pixel_count->setTransient(_c.transient, ids.curve_pixel_count);
+    _csb.monotonic_cutpoint_cache->setTransient(_c.transient, ids.monotonic_cutpoint_cache);
+    _csb.intersection->setTransient(_c.transient, ids.intersection);
+    _csb.fragment_data->setTransient(_c.transient, ids.fragment_data);
+    _csb.fragment_scan->setTransient(_c.transient, ids.fragment_scan);
 
     _csb.transformed_pos->resizeWithoutCopy(_in_curve.n_points);
     _csb.path_visible->resizeWithoutCopy(_in_path.n_paths);
@@ -1143,12 +1347,23 @@ void ScanlineVGRasterizer::prepareComputeBuffers()
     // debug
     _csb.debug = GPU_VULKAN_BUFFER(int32_t);
 
-    // uniform buffer
-    usage_flags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT 
-        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    _cub.k_trans_pos_ubo = GPU_VULKAN_BUFFER(TransPosIn);
-    _cub.k_make_inte_ubo = GPU_VULKAN_BUFFER(MakeInteIn);
+    // counts and launch arguments, read by indirect dispatches and the draw
+    {
+        VkBufferUsageFlags usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+            | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        for (auto& frame : _in_flight) {
+            frame.counts = GPU_VULKAN_BUFFER(ivec4);
+            frame.counts->resizeWithoutCopy(4);
+        }
+    }
+    _c.max_fragments = fitCapacity(static_cast<int32_t>(_in_curve.n_curves) * INITIAL_FRAGMENTS_PER_CURVE, 0);
+    _c.max_output = _c.max_fragments;
+    _c.n_fragments = _c.stride_fragments = _c.merged_fragment = _c.span = 0;
+
+    // per frame uniform data and small scene edits, edits for the next frame
+    // are staged before its slot's fence wait, hence one region more
+    _c.upload_ring = std::make_shared<vulkan::UploadRing>(_vulkanDevice, UPLOAD_RING_FRAME_SIZE, settings.framesInFlight + 1);
     
     _c.trans_pos_in.n_points = _in_curve.n_points;
     _c.trans_pos_in.w = _width;
@@ -1187,26 +1402,38 @@ void ScanlineVGRasterizer::prepareComputeBuffers()
     _c.make_inte_in.w = _width;
     _c.make_inte_in.h = _height;
     _c.make_inte_in.n_curves = _in_curve.n_curves;
-
-    _cub.k_trans_pos_ubo->set(_c.trans_pos_in, 1);
-    _cub.k_make_inte_ubo->set(_c.make_inte_in, 1);
     
     
 }
 
+/*
+* Room for 'needed' plus headroom when it outgrew 'capacity' or uses under
+* a quarter of it, else 'capacity' so the buffer layout stays put
+*/
+int32_t ScanlineVGRasterizer::fitCapacity(int32_t needed, int32_t capacity) const
+{
+    if (needed <= capacity && static_cast<int64_t>(needed) * 4 >= capacity) {
+        return capacity;
+    }
+    int64_t target = static_cast<int64_t>(needed) + needed / CAPACITY_HEADROOM_DIV + _kernal_config.block_size;
+    return static_cast<int32_t>((std::min)(target, static_cast<int64_t>(INT32_MAX / 8)));
+}
+
 void ScanlineVGRasterizer::prepareCommonComputeKernal()
 {
     auto& _k = _kernal;
+    KernalSpecialization spec = kernalSpecialization(_kernal_config.batch_size);
 
     // scan
     std::vector<VkDescriptorType> scan_dt{
+        DESC_TYPE_SB,
         DESC_TYPE_SB,
         DESC_TYPE_SB
     };
     std::vector<VkPushConstantRange> scan_pcr{
-        vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t), 0)
+        vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 2, 0)
     };
-    _k.scan = COMPUTE_KERNAL(scan_dt, COMMON_COMPUTE_SPV_DIR + "naive_scan.comp.spv", &scan_pcr);
+    _k.scan = COMPUTE_KERNAL(scan_dt, COMMON_COMPUTE_SPV_DIR + "naive_scan.comp.spv", &scan_pcr, spec.info());
 
     // seg_sort
     std::vector<VkDescriptorType> seg_sort_dt{
@@ -1217,8 +1444,182 @@ void ScanlineVGRasterizer::prepareCommonComputeKernal()
     std::vector<VkPushConstantRange> seg_sort_pcr{
         vk::initializer::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(int32_t) * 2, 0)
     };
-    _k.seg_sort = COMPUTE_KERNAL(seg_sort_dt, COMMON_COMPUTE_SPV_DIR + "naive_seg_sort_pairs.comp.spv", &seg_sort_pcr);
+    _k.seg_sort = COMPUTE_KERNAL(seg_sort_dt, COMMON_COMPUTE_SPV_DIR + "naive_seg_sort_pairs.comp.spv", &seg_sort_pcr, spec.info());
+
+}
 
+
+KernalSpecialization ScanlineVGRasterizer::kernalSpecialization(int32_t work_group_size) const
+{
+    KernalSpecialization spec;
+    spec.set(SPEC_WORK_GROUP_SIZE, static_cast<uint32_t>(work_group_size))
+        ->set(SPEC_FRAG_SIZE, FRAG_SIZE)
+        ->set(SPEC_BLOCK_SIZE, static_cast<uint32_t>(_kernal_config.block_size));
+    return spec;
+}
+
+bool ScanlineVGRasterizer::fitsDevice(const KernalConfig& config) const
+{
+    auto& limits = _vulkanDevice->properties.limits;
+    auto fits = [&](int32_t size, size_t shared_bytes) {
+        return size > 0
+            && static_cast<uint32_t>(size) <= limits.maxComputeWorkGroupSize[0]
+            && static_cast<uint32_t>(size) <= limits.maxComputeWorkGroupInvocations
+            && shared_bytes <= limits.maxComputeSharedMemorySize;
+    };
+    // make_intersection_* keep 15 floats per invocation in shared memory,
+    // naive_scan two ints per invocation and one more
+    return fits(config.block_size, sizeof(float) * 15 * config.block_size)
+        && fits(config.batch_size, sizeof(int32_t) * (2 * config.batch_size + 1));
+}
+
+// device and driver, then the scene by its sizes
+std::string ScanlineVGRasterizer::kernalConfigKey() const
+{
+    auto& props = _vulkanDevice->properties;
+    const uint32_t scene[4] = {
+        _compute.geometry_input.n_geometries, _compute.path_input.n_paths
+        , _compute.curve_input.n_curves, _compute.curve_input.n_points
+    };
+    char key[96];
+    snprintf(key, sizeof(key), "%04x:%04x:%08x:%016llx"
+        , props.vendorID, props.deviceID, props.driverVersion
+        , static_cast<unsigned long long>(fnv1a(scene, sizeof(scene))));
+    return key;
+}
+
+/*
+* The configuration stored for this device and scene, else the default
+* one halved until the device fits it
+*/
+void ScanlineVGRasterizer::loadKernalConfig()
+{
+    KernalConfig config;
+    std::string key = kernalConfigKey();
+    std::ifstream in(KERNAL_CONFIG_FILE);
+    std::string line;
+    bool stored = false;
+    while (!stored && std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string line_key;
+        KernalConfig line_config;
+        if (fields >> line_key >> line_config.block_size >> line_config.batch_size
+            && line_key == key && fitsDevice(line_config)) {
+            config = line_config;
+            stored = true;
+        }
+    }
+    while (!stored && !fitsDevice(config) && config.block_size > 32) {
+        KernalConfig block_half = { config.block_size / 2, config.batch_size };
+        config = fitsDevice(block_half) || config.batch_size <= 32 ? block_half : KernalConfig{ config.block_size, config.batch_size / 2 };
+    }
+    _kernal_config = config;
+    printf("kernal config: block %d, batch %d%s\n", config.block_size, config.batch_size
+        , stored ? " (stored)" : "");
+}
+
+void ScanlineVGRasterizer::saveKernalConfig() const
+{
+    std::string key = kernalConfigKey();
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(KERNAL_CONFIG_FILE);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, key.size() + 1, key + " ") != 0) {
+                lines.push_back(line);
+            }
+        }
+    }
+    std::ofstream out(KERNAL_CONFIG_FILE, std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error(KERNAL_CONFIG_FILE + " open failed");
+    }
+    for (auto& line : lines) {
+        out << line << "\n";
+    }
+    out << key << " " << _kernal_config.block_size << " " << _kernal_config.batch_size << "\n";
+}
+
+/*
+* Run the compute chain of the loaded scene with every configuration the
+* device fits and keep the fastest. Times are the compute graph's
+* timestamps, or host time around the submit where the queue has none.
+*/
+void ScanlineVGRasterizer::autoTuneKernal()
+{
+    auto& _c = _compute;
+    auto& frame = _in_flight[0];
+    bool dump_schedule = _c.dump_schedule;
+    _c.dump_schedule = false;
+    // no draw acquires the runs' output, keep it on the compute family
+    bool async = _c.async;
+    _c.async = false;
+
+    KernalConfig best = _kernal_config;
+    double best_ms = -1.0;
+    for (int32_t block_size : AUTOTUNE_BLOCK_SIZES) {
+        for (int32_t batch_size : AUTOTUNE_BATCH_SIZES) {
+            KernalConfig config = { block_size, batch_size };
+            if (!fitsDevice(config)) {
+                continue;
+            }
+            VK_CHECK_RESULT(vkDeviceWaitIdle(_device));
+            _kernal_config = config;
+            prepareCommonComputeKernal();
+            prepareScanlineKernal();
+
+            // the first runs also grow the buffers to the scene
+            double ms = 0.0;
+            for (uint32_t i = 0; i < AUTOTUNE_WARMUP_RUNS + AUTOTUNE_RUNS; ++i) {
+                double run_ms = timeComputeRun(frame);
+                if (i >= AUTOTUNE_WARMUP_RUNS) {
+                    ms += run_ms;
+                }
+            }
+            ms /= AUTOTUNE_RUNS;
+            printf("auto-tune: block %d, batch %d: %.3f ms\n", block_size, batch_size, ms);
+            if (best_ms < 0.0 || ms < best_ms) {
+                best = config;
+                best_ms = ms;
+            }
+        }
+    }
+
+    VK_CHECK_RESULT(vkDeviceWaitIdle(_device));
+    _kernal_config = best;
+    prepareCommonComputeKernal();
+    prepareScanlineKernal();
+    frame.complete = false;
+    _c.dump_schedule = dump_schedule;
+    _c.async = async;
+    saveKernalConfig();
+    printf("auto-tune: block %d, batch %d is the fastest, stored in %s\n"
+        , best.block_size, best.batch_size, KERNAL_CONFIG_FILE.c_str());
+}
+
+double ScanlineVGRasterizer::timeComputeRun(InFlightFrame& frame)
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+    VkSemaphore done = recordCompute(frame);
+
+    // nothing draws it, the compute queue waits the semaphore back
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo submit = vk::initializer::submitInfo();
+    submit.waitSemaphoreCount = 1;
+    submit.pWaitSemaphores = &done;
+    submit.pWaitDstStageMask = &wait_stage;
+    VK_CHECK_RESULT(vkQueueSubmit(_compute.queue, 1, &submit, VK_NULL_HANDLE));
+    VK_CHECK_RESULT(vkQueueWaitIdle(_compute.queue));
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    takeFrameCounts(frame);
+    // the queue is idle, any region of the ring is free
+    _compute.upload_ring->beginFrame();
+    if (frame.graph->collectTimings()) {
+        return frame.graph->totalMs();
+    }
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
 }
 
 }
\ No newline at end of file
@@ -14,9 +14,13 @@
 #include "../vk/vk_debug.h"
 #include "../vulkan/vk_vg_rasterizer.h"
 #include "../vulkan/vulkan_buffer.h"
+#include "../vulkan/vulkan_upload.h"
+#include "../vulkan/vulkan_readback.h"
 #include "../rasterizer.h"
 
 #include "../common/compute_kernal.h"
+#include "../common/compute_batch.h"
+#include "../common/compute_graph.h"
 #include "compute_ubo.h"
 #include "vk_vg_data.h"
 
@@ -40,10 +44,31 @@ public:
 
     void loadVG(std::shared_ptr<VGContainer> vg) override;
 
+    void loadVG(const VGSceneView& scene) override;
+
     void setMVP(const glm::mat4& m) override;
 
+    void setPathTransforms(uint32_t first_path, const glm::mat3x2* m, uint32_t count) override;
+
     //void viewport(int x, int y, int w, int h) override;
 
+    // frames drawn and how many of them reused a cached compute output
+    struct FrameCacheStats {
+        uint64_t frames = 0;
+        uint64_t cached = 0;
+        // cached frames in a row up to now
+        uint32_t streak = 0;
+    };
+    const FrameCacheStats& frameCacheStats() const { return _frame_cache; }
+
+    // print the compute passes, their order and timings once the next
+    // timed frame is back
+    void dumpComputeSchedule();
+
+    // benchmark the kernal configurations the device fits at the first
+    // frame and store the fastest for this device and scene
+    void setAutoTune(bool enabled) { _auto_tune = enabled; }
+
     ~ScanlineVGRasterizer() {
         VK_CHECK_RESULT(vkDeviceWaitIdle(_device));
     }
@@ -67,6 +92,19 @@ private:
 
     void drawFrame();
 
+    // everything the compute chain reads that can change between frames
+    struct FrameKey {
+        uint64_t mvp_hash = 0;
+        uint64_t scene_generation = 0;
+        uint32_t width = 0, height = 0;
+
+        bool operator==(const FrameKey& o) const {
+            return mvp_hash == o.mvp_hash && scene_generation == o.scene_generation
+                && width == o.width && height == o.height;
+        }
+    };
+    FrameKey frameKey() const;
+
     void drawDebug();
 
     void prepareTexelBuffers();
@@ -82,6 +120,34 @@ private:
     void prepareComputeBuffers();
     void prepareCommonComputeKernal();
 
+    struct InFlightFrame;
+    VkSemaphore recordCompute(InFlightFrame& frame);
+    void takeFrameCounts(InFlightFrame& frame);
+    void cmdExpandInstances(VkCommandBuffer cmd);
+    // give the heap the levels 'buffer' is used in
+    void planTransient(const ComputeGraph& graph, VkBuffer buffer, uint32_t id);
+
+    void addComputeToGraphicsBarriers(VkCommandBuffer cmd, InFlightFrame& frame);
+
+    int32_t fitCapacity(int32_t needed, int32_t capacity) const;
+
+    void prepareScanlineKernal();
+
+    // work group sizes the kernals are specialized with
+    struct KernalConfig {
+        // kernals over points, curves and fragments
+        int32_t block_size = 256;
+        // naive_scan and naive_seg_sort_pairs, one work group each
+        int32_t batch_size = 1024;
+    };
+    KernalSpecialization kernalSpecialization(int32_t work_group_size) const;
+    bool fitsDevice(const KernalConfig& config) const;
+    std::string kernalConfigKey() const;
+    void loadKernalConfig();
+    void saveKernalConfig() const;
+    void autoTuneKernal();
+    double timeComputeRun(InFlightFrame& frame);
+
 private:
 
     //std::shared_ptr<VGContainer> _vgContainer;
@@ -100,18 +166,19 @@ private:
             VkPipeline scanline;
         }pipelines;
 
-        VULKAN_BUFFER_PTR(ivec4) output_buf;
-        VkBufferView output_buf_view;
-        
     } graphics;
 
     struct {
 
+        VkVGInputGeometryData geometry_input;
         VkVGInputCurveData curve_input;
         VkVGInputPathData path_input;
 
         VkQueue queue;
         VkCommandPool cmd_pool;
+        // compute and graphics queues are of different families, the
+        // buffers the draw reads change owner between them
+        bool async;
 
         struct {
             // transfromed
@@ -124,6 +191,8 @@ private:
             //VULKAN_BUFFER_PTR(uint32_t) monotonic_n_cuts_cache;
             VULKAN_BUFFER_PTR(float) intersection;
             VULKAN_BUFFER_PTR(int32_t) fragment_data;
+            // scan of the merged fragment and span flags, aliases intersection
+            VULKAN_BUFFER_PTR(int32_t) fragment_scan;
 
             //for debug
             VULKAN_BUFFER_PTR(int32_t) debug;
@@ -133,27 +202,83 @@ private:
         TransPosIn trans_pos_in;
         MakeInteIn make_inte_in;
 
+        // counts of the last finished frame
         int32_t n_fragments;
         int32_t stride_fragments;
         int32_t merged_fragment;
         int32_t span;
 
+        // room of the fragment and output buffers, the GPU clips to it
+        int32_t max_fragments;
+        int32_t max_output;
+
 
+        // uniform data and path transform edits of the frame
+        std::shared_ptr<vulkan::UploadRing> upload_ring;
+        // memory of the storage buffers that only live during part of a frame
+        std::shared_ptr<vk::TransientHeap> transient;
         struct {
-            VULKAN_BUFFER_PTR(TransPosIn) k_trans_pos_ubo;
-            VULKAN_BUFFER_PTR(MakeInteIn) k_make_inte_ubo;
-        } uniform_buffers;
+            uint32_t transformed_pos;
+            uint32_t path_visible;
+            uint32_t curve_pixel_count;
+            uint32_t monotonic_cutpoint_cache;
+            uint32_t intersection;
+            uint32_t fragment_data;
+            uint32_t fragment_scan;
+        } transient_ids;
+        // print the compute graph with the next timings read
+        bool dump_schedule;
+        // set by loadVG, the instances are not expanded yet
+        bool expand_pending = false;
 
         // CPU-GPU synchronization
         //VkFence fence;
+        std::shared_ptr<vulkan::ReadbackRing> readback;
     } _compute;
 
+    // what a frame in flight owns, indexed by _frameIndex; the compute
+    // intermediates are shared, frames run their compute one after another
+    struct InFlightFrame {
+        // command buffer all kernels of the frame record into
+        std::shared_ptr<ComputeBatch> batch;
+        // passes of the compute chain, rebuilt every compute
+        std::shared_ptr<ComputeGraph> graph;
+
+        // counts and indirect launch arguments frame_setup writes
+        VULKAN_BUFFER_PTR(ivec4) counts;
+        uint32_t counts_slot;
+        uint32_t needed_slot;
+        bool counts_pending = false;
+
+        // merged fragments and spans the draw reads
+        VULKAN_BUFFER_PTR(ivec4) output_buf;
+        VkBufferView output_buf_view = VK_NULL_HANDLE;
+        // buffer the view was created for
+        VkBuffer output_buf_view_target = VK_NULL_HANDLE;
+        // compute released output_buf and counts, the draw acquires them
+        bool acquire_pending = false;
+
+        // what output_buf was computed from, complete once its counts
+        // came back without overflow
+        FrameKey key;
+        bool complete = false;
+    };
+    std::vector<InFlightFrame> _in_flight;
+
+    // bumped by every scene upload and path transform edit
+    uint64_t _scene_generation = 0;
+    FrameCacheStats _frame_cache;
+
+    KernalConfig _kernal_config;
+    bool _auto_tune = false;
+
     struct {
         // common
         std::shared_ptr<ComputeKernal> scan;
         std::shared_ptr<ComputeKernal> seg_sort;
 
         // for scanline path rendering
+        std::shared_ptr<ComputeKernal> expand_instances;
         std::shared_ptr<ComputeKernal> transform_pos;
         std::shared_ptr<ComputeKernal> make_intersection_0;
         std::shared_ptr<ComputeKernal> make_intersection_1;
@@ -162,6 +287,8 @@ private:
         std::shared_ptr<ComputeKernal> mark_merged_fragment_and_span;
 
         std::shared_ptr<ComputeKernal> gen_merged_fragment_and_span;
+
+        std::shared_ptr<ComputeKernal> frame_setup;
     } _kernal;
 
 
@@ -173,7 +300,38 @@ private:
     const std::string SURFACE_SPV_DIR = "shaders/scanline/surface/spv/";
     const std::string COMPUTE_SPV_DIR = "shaders/scanline/compute/spv/";
     const std::string COMMON_COMPUTE_SPV_DIR = "shaders/common/spv/";
-    const int BLOCK_SIZE = 256;
+    // specialization constant ids the compute shaders share
+    enum SpecConstant : uint32_t {
+        SPEC_WORK_GROUP_SIZE = 0,
+        SPEC_FRAG_SIZE = 1,
+        // work group size of the kernals over fragments, for the shaders
+        // that size dispatches with it
+        SPEC_BLOCK_SIZE = 2
+    };
+    // side of a fragment in pixels, the output layout depends on it
+    const uint32_t FRAG_SIZE = 2;
+    // configurations stored by the auto-tune, one line per device and scene
+    const std::string KERNAL_CONFIG_FILE = "kernal_config.txt";
+    const std::array<int32_t, 4> AUTOTUNE_BLOCK_SIZES = { 64, 128, 256, 512 };
+    const std::array<int32_t, 3> AUTOTUNE_BATCH_SIZES = { 256, 512, 1024 };
+    const uint32_t AUTOTUNE_WARMUP_RUNS = 3;
+    const uint32_t AUTOTUNE_RUNS = 10;
+    const uint32_t READBACK_SLOTS = 16;
+    const VkDeviceSize UPLOAD_RING_FRAME_SIZE = 64 << 10;
+    // frame_setup.comp stages and where its launch arguments are
+    enum FrameSetupStage : int32_t {
+        SETUP_FRAGMENTS,
+        SETUP_OUTPUT
+    };
+    const VkDeviceSize FRAME_COUNTS_DISPATCH_OFFSET = sizeof(int32_t) * 8;
+    const VkDeviceSize FRAME_COUNTS_DRAW_OFFSET = sizeof(int32_t) * 12;
+    // capacities are the last frame's counts plus a quarter, the first
+    // frame guesses from the curve count
+    const int32_t CAPACITY_HEADROOM_DIV = 4;
+    const int32_t INITIAL_FRAGMENTS_PER_CURVE = 16;
+    // sizes follow the fragment count, grow with room and give memory
+    // back after 120 frames in a row that needed under a quarter of it
+    const vulkan::BufferPolicy TRANSIENT_BUFFER_POLICY = { 1.5, 0.125, false, 120, 0.25 };
 
 };
 
@@ -6,30 +6,63 @@
 #include <glm/glm.hpp>
 #include <memory>
 
-#define NEW_VULKAN_BUFFER(T, device, usage, mem_prop, queue) (std::make_shared<vulkan::VulkanBuffer<T>>(device, usage, mem_prop, queue)); 
+#define NEW_VULKAN_BUFFER(T, device, usage, mem_prop, queue, queue_family) (std::make_shared<vulkan::VulkanBuffer<T>>(device, usage, mem_prop, queue, queue_family)); 
 
 namespace Galaxysailing {
 using namespace glm;
 
+// unique geometry of the scene, uploaded once and shared by instances
+struct VkVGInputGeometryData {
+	VULKAN_BUFFER_PTR(vec2) position;
+
+	VULKAN_BUFFER_PTR(uint32_t) curve_position_map;
+	// packed, one byte per curve
+	VULKAN_BUFFER_PTR(uint8_t) curve_type;
+	// rational quadratic weight, 0 for other curve types (the cartesian
+	// control point keeps it valid under the affine camera transform)
+	VULKAN_BUFFER_PTR(float) curve_arc_w;
+
+	// n_geometries + 1 offsets into 'position' / the curve arrays
+	VULKAN_BUFFER_PTR(uint32_t) point_begin;
+	VULKAN_BUFFER_PTR(uint32_t) curve_begin;
+
+	uint32_t n_geometries;
+};
+
+// per expanded curve / point, generated on the GPU by expand_instances.
+// When every path is its own geometry the curve arrays are the geometry
+// ones, only the path indices are generated
 struct VkVGInputCurveData{
 	// point data
-	VULKAN_BUFFER_PTR(vec2) position;
 	VULKAN_BUFFER_PTR(uint32_t) position_path_idx;
 
 	// curve
 	VULKAN_BUFFER_PTR(uint32_t) curve_position_map;
-	VULKAN_BUFFER_PTR(uint32_t) curve_type;
+	// packed, one byte per curve
+	VULKAN_BUFFER_PTR(uint8_t) curve_type;
 	VULKAN_BUFFER_PTR(uint32_t) curve_path_idx;
+	VULKAN_BUFFER_PTR(float) curve_arc_w;
 
 	// numbers
 	uint32_t n_curves;
 	uint32_t n_points;
+	// path i draws geometry i, see above
+	bool paths_are_geometries;
 
 };
 
 struct VkVGInputPathData {
-	VULKAN_BUFFER_PTR(uint32_t) fill_rule;
+	// packed, one byte per path
+	VULKAN_BUFFER_PTR(uint8_t) fill_rule;
 	VULKAN_BUFFER_PTR(uint32_t) fill_info;
+	// dyn_affine of each path, applied before the camera matrix
+	VULKAN_BUFFER_PTR(mat3x2) transform;
+
+	// instance table: geometry id and n_paths + 1 offsets of the
+	// expanded points / curves
+	VULKAN_BUFFER_PTR(uint32_t) geometry;
+	VULKAN_BUFFER_PTR(uint32_t) point_begin;
+	VULKAN_BUFFER_PTR(uint32_t) curve_begin;
 
 	uint32_t n_paths;
 };
@@ -0,0 +1,222 @@
+#include "bvg.h"
+#include "rvg.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+namespace Galaxysailing {
+
+static const char BVG_MAGIC[4] = { 'B', 'V', 'G', '\0' };
+
+template<class T>
+static void bindSection(const MappedFile& file, const BVGHeader& header
+	, BVGHeader::Section sec, uint32_t count, VGSpan<T>& span)
+{
+	auto& s = header.sections[sec];
+	if (s.offset % BVG::ALIGNMENT != 0
+		|| s.offset > file.size()
+		|| s.bytes > file.size() - s.offset
+		|| s.bytes != static_cast<uint64_t>(count) * sizeof(T)) {
+		throw std::runtime_error("BVG::load broken section table");
+	}
+	span.data = reinterpret_cast<const T*>(file.data() + s.offset);
+	span.size = count;
+}
+
+// 'begin' holds n + 1 non decreasing offsets from 0 to 'end'
+static bool isPrefix(const VGSpan<uint32_t>& begin, uint32_t end)
+{
+	if (begin.data[0] != 0 || begin.data[begin.size - 1] != end) {
+		return false;
+	}
+	for (uint32_t i = 1; i < begin.size; ++i) {
+		if (begin.data[i] < begin.data[i - 1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// points a curve of type 't' reads, 0 for a type the kernels don't know
+static uint32_t pointsOf(uint8_t t)
+{
+	switch (static_cast<CurveType>(t)) {
+	case CurveType::LINE:
+	case CurveType::QUADRIC:
+	case CurveType::CUBIC:
+	case CurveType::ARC:
+		return t & 7;
+	default:
+		return 0;
+	}
+}
+
+/*
+* The shaders index with these arrays unchecked, a broken file would
+* read and write out of the buffers
+*/
+static const char* checkIndices(const VGSceneView& v, uint32_t n_geometry_points, uint32_t n_geometry_curves)
+{
+	if (!isPrefix(v.geometry_point_begin, n_geometry_points)) {
+		return "geometry point begin";
+	}
+	if (!isPrefix(v.geometry_curve_begin, n_geometry_curves)) {
+		return "geometry curve begin";
+	}
+	for (uint32_t c = 0; c < n_geometry_curves; ++c) {
+		if (pointsOf(v.curve_type.data[c]) == 0) {
+			return "curve type";
+		}
+	}
+	// every curve reads its points from its own geometry, in order
+	for (uint32_t g = 0; g < v.n_geometries; ++g) {
+		uint32_t point_begin = v.geometry_point_begin.data[g];
+		uint32_t point_end = v.geometry_point_begin.data[g + 1];
+		uint32_t prev = point_begin;
+		for (uint32_t c = v.geometry_curve_begin.data[g]; c < v.geometry_curve_begin.data[g + 1]; ++c) {
+			uint32_t p = v.curve_position_map.data[c];
+			if (p < prev || p > point_end || point_end - p < pointsOf(v.curve_type.data[c])) {
+				return "curve position map";
+			}
+			prev = p;
+		}
+	}
+	// each path expands to exactly its geometry's points and curves
+	if (!isPrefix(v.path_point_begin, v.n_points) || !isPrefix(v.path_curve_begin, v.n_curves)) {
+		return "path begin";
+	}
+	for (uint32_t pi = 0; pi < v.n_paths; ++pi) {
+		uint32_t g = v.path_geometry.data[pi];
+		if (g >= v.n_geometries) {
+			return "path geometry";
+		}
+		if (v.path_point_begin.data[pi + 1] - v.path_point_begin.data[pi]
+				!= v.geometry_point_begin.data[g + 1] - v.geometry_point_begin.data[g]
+			|| v.path_curve_begin.data[pi + 1] - v.path_curve_begin.data[pi]
+				!= v.geometry_curve_begin.data[g + 1] - v.geometry_curve_begin.data[g]) {
+			return "path geometry";
+		}
+	}
+	return nullptr;
+}
+
+void BVG::load(const std::string& filename)
+{
+	_file.open(filename);
+
+	if (_file.size() < sizeof(BVGHeader)) {
+		throw std::runtime_error("BVG::load \"" + filename + "\" is too small");
+	}
+	BVGHeader header;
+	memcpy(&header, _file.data(), sizeof(BVGHeader));
+	if (memcmp(header.magic, BVG_MAGIC, 4) != 0) {
+		throw std::runtime_error("BVG::load \"" + filename + "\" is not a bvg file");
+	}
+	if (header.version != VERSION || header.alignment != ALIGNMENT || header.header_size != sizeof(BVGHeader)) {
+		throw std::runtime_error("BVG::load \"" + filename + "\" unsupported version "
+			+ std::to_string(header.version) + ", convert it again");
+	}
+
+	_view = VGSceneView();
+	_view.vp = glm::vec4(header.vp[0], header.vp[1], header.vp[2], header.vp[3]);
+	_view.win = glm::vec4(header.win[0], header.win[1], header.win[2], header.win[3]);
+	_view.n_points = header.n_points;
+	_view.n_curves = header.n_curves;
+	_view.n_paths = header.n_paths;
+	_view.n_geometries = header.n_geometries;
+
+	uint32_t n_geometry_points = header.n_geometry_points;
+	uint32_t n_geometry_curves = header.n_geometry_curves;
+	bindSection(_file, header, BVGHeader::POSITION, n_geometry_points, _view.position);
+	bindSection(_file, header, BVGHeader::CURVE_POSITION_MAP, n_geometry_curves, _view.curve_position_map);
+	bindSection(_file, header, BVGHeader::CURVE_TYPE, vgPackedBytes(n_geometry_curves), _view.curve_type);
+	bindSection(_file, header, BVGHeader::CURVE_ARC_W, n_geometry_curves, _view.curve_arc_w);
+	bindSection(_file, header, BVGHeader::GEOMETRY_POINT_BEGIN, header.n_geometries + 1, _view.geometry_point_begin);
+	bindSection(_file, header, BVGHeader::GEOMETRY_CURVE_BEGIN, header.n_geometries + 1, _view.geometry_curve_begin);
+	bindSection(_file, header, BVGHeader::PATH_GEOMETRY, header.n_paths, _view.path_geometry);
+	bindSection(_file, header, BVGHeader::PATH_POINT_BEGIN, header.n_paths + 1, _view.path_point_begin);
+	bindSection(_file, header, BVGHeader::PATH_CURVE_BEGIN, header.n_paths + 1, _view.path_curve_begin);
+	bindSection(_file, header, BVGHeader::FILL_RULE, vgPackedBytes(header.n_paths), _view.fill_rule);
+	bindSection(_file, header, BVGHeader::FILL_INFO, header.n_paths, _view.fill_info);
+	bindSection(_file, header, BVGHeader::PATH_TRANSFORM, header.n_paths, _view.path_transform);
+	if (const char* broken = checkIndices(_view, n_geometry_points, n_geometry_curves)) {
+		throw std::runtime_error("BVG::load \"" + filename + "\" broken " + broken + " array");
+	}
+
+	std::cout << "---------- vg load success ---------\n";
+}
+
+void BVG::save(const std::string& filename, const VGSceneView& scene)
+{
+	BVGHeader header;
+	memset(&header, 0, sizeof(BVGHeader));
+	memcpy(header.magic, BVG_MAGIC, 4);
+	header.version = VERSION;
+	header.alignment = ALIGNMENT;
+	header.header_size = sizeof(BVGHeader);
+	header.n_points = scene.n_points;
+	header.n_curves = scene.n_curves;
+	header.n_paths = scene.n_paths;
+	header.n_geometries = scene.n_geometries;
+	header.n_geometry_points = scene.position.size;
+	header.n_geometry_curves = scene.curve_arc_w.size;
+	for (int i = 0; i < 4; ++i) {
+		header.vp[i] = scene.vp[i];
+		header.win[i] = scene.win[i];
+	}
+
+	struct {
+		const void* data;
+		uint64_t bytes;
+	} sections[BVGHeader::N_SECTIONS] = {
+		{ scene.position.data, scene.position.size * sizeof(glm::vec2) },
+		{ scene.curve_position_map.data, scene.curve_position_map.size * sizeof(uint32_t) },
+		{ scene.curve_type.data, scene.curve_type.size * sizeof(uint8_t) },
+		{ scene.curve_arc_w.data, scene.curve_arc_w.size * sizeof(float) },
+		{ scene.geometry_point_begin.data, scene.geometry_point_begin.size * sizeof(uint32_t) },
+		{ scene.geometry_curve_begin.data, scene.geometry_curve_begin.size * sizeof(uint32_t) },
+		{ scene.path_geometry.data, scene.path_geometry.size * sizeof(uint32_t) },
+		{ scene.path_point_begin.data, scene.path_point_begin.size * sizeof(uint32_t) },
+		{ scene.path_curve_begin.data, scene.path_curve_begin.size * sizeof(uint32_t) },
+		{ scene.fill_rule.data, scene.fill_rule.size * sizeof(uint8_t) },
+		{ scene.fill_info.data, scene.fill_info.size * sizeof(uint32_t) },
+		{ scene.path_transform.data, scene.path_transform.size * sizeof(glm::mat3x2) },
+	};
+
+	auto align = [](uint64_t v) { return (v + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; };
+	uint64_t offset = align(sizeof(BVGHeader));
+	for (int i = 0; i < BVGHeader::N_SECTIONS; ++i) {
+		header.sections[i].offset = offset;
+		header.sections[i].bytes = sections[i].bytes;
+		offset = align(offset + sections[i].bytes);
+	}
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if (!fout.is_open()) {
+		throw std::runtime_error("BVG::save can't open file \"" + filename + "\"");
+	}
+	const char padding[ALIGNMENT] = {};
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(BVGHeader));
+	uint64_t pos = sizeof(BVGHeader);
+	for (int i = 0; i < BVGHeader::N_SECTIONS; ++i) {
+		fout.write(padding, header.sections[i].offset - pos);
+		fout.write(static_cast<const char*>(sections[i].data), sections[i].bytes);
+		pos = header.sections[i].offset + sections[i].bytes;
+	}
+	if (!fout) {
+		throw std::runtime_error("BVG::save failed to write \"" + filename + "\"");
+	}
+}
+
+void BVG::convert(const std::string& rvg_filename, const std::string& bvg_filename)
+{
+	RVG rvg;
+	rvg.setShareEndpoints(true);
+	rvg.load(rvg_filename);
+	VGScene scene(*rvg.getVGContainer());
+	save(bvg_filename, scene.view());
+}
+
+}
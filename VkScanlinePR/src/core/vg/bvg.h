@@ -0,0 +1,86 @@
+#pragma once
+#ifndef GALAXYSAILING_BVG_H_
+#define GALAXYSAILING_BVG_H_
+
+#include <string>
+#include <cstdint>
+
+#include "mapped_file.h"
+#include "vg_scene.h"
+
+namespace Galaxysailing {
+
+/*
+* Binary precompiled scene (.bvg)
+*
+* A fixed header followed by the VGScene arrays, each section starts
+* at a multiple of 'alignment' bytes. All values are little endian. The
+* file is memory mapped on load and the sections are handed to the
+* rasterizer as they are, there is nothing left to parse or flatten.
+*/
+struct BVGHeader {
+	enum Section {
+		POSITION = 0,
+		CURVE_POSITION_MAP,
+		CURVE_TYPE,
+		CURVE_ARC_W,
+		GEOMETRY_POINT_BEGIN,
+		GEOMETRY_CURVE_BEGIN,
+		PATH_GEOMETRY,
+		PATH_POINT_BEGIN,
+		PATH_CURVE_BEGIN,
+		FILL_RULE,
+		FILL_INFO,
+		PATH_TRANSFORM,
+		N_SECTIONS
+	};
+
+	char magic[4];
+	uint32_t version;
+	uint32_t alignment;
+	uint32_t header_size;
+
+	// expanded counts
+	uint32_t n_points;
+	uint32_t n_curves;
+	uint32_t n_paths;
+	uint32_t n_geometries;
+
+	// unique geometry counts
+	uint32_t n_geometry_points;
+	uint32_t n_geometry_curves;
+	uint32_t reserved[2];
+
+	float vp[4];
+	float win[4];
+
+	struct {
+		uint64_t offset;
+		uint64_t bytes;
+	} sections[N_SECTIONS];
+};
+
+class BVG {
+public:
+	static const uint32_t VERSION = 5;
+	static const uint32_t ALIGNMENT = 16;
+
+	// map 'filename', validate the header, the section table and the index arrays
+	void load(const std::string& filename);
+
+	// view into the mapped file, valid while this object is alive
+	const VGSceneView& view() const { return _view; }
+
+	static void save(const std::string& filename, const VGSceneView& scene);
+
+	// rvg -> bvg
+	static void convert(const std::string& rvg_filename, const std::string& bvg_filename);
+
+private:
+	MappedFile _file;
+	VGSceneView _view;
+};
+
+}
+
+#endif
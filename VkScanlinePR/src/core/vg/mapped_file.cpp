@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Galaxysailing {
+
+void MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ
+		, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("MappedFile::open can't open file \"" + filename + "\"");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("MappedFile::open can't get size of \"" + filename + "\"");
+	}
+	_file = file;
+	_size = static_cast<size_t>(file_size.QuadPart);
+	if (_size == 0) {
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		throw std::runtime_error("MappedFile::open can't map file \"" + filename + "\"");
+	}
+	_mapping = mapping;
+	_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	_fd = ::open(filename.c_str(), O_RDONLY);
+	if (_fd < 0) {
+		throw std::runtime_error("MappedFile::open can't open file \"" + filename + "\"");
+	}
+	struct stat st;
+	if (fstat(_fd, &st) != 0) {
+		close();
+		throw std::runtime_error("MappedFile::open can't get size of \"" + filename + "\"");
+	}
+	_size = static_cast<size_t>(st.st_size);
+	if (_size == 0) {
+		return;
+	}
+
+	void* ptr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (ptr != MAP_FAILED) {
+		madvise(ptr, _size, MADV_SEQUENTIAL);
+		_data = static_cast<const char*>(ptr);
+	}
+#endif
+
+	if (_data == nullptr) {
+		close();
+		throw std::runtime_error("MappedFile::open can't map file \"" + filename + "\"");
+	}
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_data) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping) {
+		CloseHandle(static_cast<HANDLE>(_mapping));
+	}
+	if (_file) {
+		CloseHandle(static_cast<HANDLE>(_file));
+	}
+	_mapping = nullptr;
+	_file = nullptr;
+#else
+	if (_data) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+	if (_fd >= 0) {
+		::close(_fd);
+	}
+	_fd = -1;
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef GALAXYSAILING_MAPPED_FILE_H_
+#define GALAXYSAILING_MAPPED_FILE_H_
+
+#include <string>
+#include <cstddef>
+
+namespace Galaxysailing {
+
+/*
+* Read-only memory mapping of a whole file.
+* The view stays valid until the object is destroyed.
+*/
+class MappedFile {
+public:
+	MappedFile() {}
+	explicit MappedFile(const std::string& filename) { open(filename); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	void open(const std::string& filename);
+	void close();
+
+	const char* data() const { return _data; }
+	size_t size() const { return _size; }
+
+	const char* begin() const { return _data; }
+	const char* end() const { return _data + _size; }
+
+private:
+	const char* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+};
+
+}
+
+#endif
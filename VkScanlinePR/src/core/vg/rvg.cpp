@@ -1,24 +1,49 @@
 #include "rvg.h"
+#include "rvg_tokenizer.h"
+#include "mapped_file.h"
+#include "../common/thread_pool.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 #include <glm/glm.hpp>
 namespace Galaxysailing {
 
-void RVG::load(const std::string& filename)
+void RVG::load(const std::string& filename, RVGLoadMode mode)
 {
-	std::ifstream fin;
-	fin.open(filename);
-	if (!fin.is_open()) {
-		throw std::runtime_error("RVG::load can't open file \"" + filename + "\"");
-	}
-	
 	_vgContainer = std::make_shared<VGContainer>();
+	_vgContainer->shareEndpoints = _shareEndpoints;
+
+	if (mode == RVGLoadMode::MAPPED || mode == RVGLoadMode::PARALLEL) {
+		MappedFile file(filename);
+		RVGTokenizer tk(file.begin(), file.end());
+
+		parse_header(tk);
 
-	parse_header(fin);
+		if (mode == RVGLoadMode::PARALLEL) {
+			parse_paths_parallel(tk.position(), file.end());
+		}
+		else {
+			parse_paths(tk, *_vgContainer);
+		}
+	}
+	else {
+		std::ifstream fin;
+		fin.open(filename);
+		if (!fin.is_open()) {
+			throw std::runtime_error("RVG::load can't open file \"" + filename + "\"");
+		}
+
+		parse_header(fin);
+
+		parse_paths(fin);
+	}
 
-	parse_paths(fin);
+	_vgContainer->buildInstances();
 
 	std::cout << "---------- vg load success ---------\n";
 
@@ -107,7 +132,7 @@ void RVG::parse_paths(std::ifstream& fin)
 
 		return v;
 	};
-	int last_path_vertex_number = -1;
+	size_t last_path_vertex_number = static_cast<size_t>(-1);
 
 	// process each path loop
 	while (fin >> tstr) {
@@ -151,8 +176,7 @@ void RVG::parse_paths(std::ifstream& fin)
 
 		glm::vec2 p[4];
 
-		int path_vertex_begin = vg.pointData.pos.size();
-		int contour_vertex_begin = path_vertex_begin;
+		int contour_curve_begin = vg.curveData.curveIndex + 1;
 		bool closed = false;
 
 		// process curve
@@ -162,7 +186,7 @@ void RVG::parse_paths(std::ifstream& fin)
 			}
 			
 			char cmd = tstr[0];
-			if (std::string("MmZzLlCcAa").find(cmd) == std::string::npos) {
+			if (std::string("MmZzLlQqCcAa").find(cmd) == std::string::npos) {
 				if (tstr != "fL") {
 					break;
 				}
@@ -173,7 +197,7 @@ void RVG::parse_paths(std::ifstream& fin)
 			switch (cmd) {
 			case 'M':
 				p[0] = read_point();
-				contour_vertex_begin = vg.pointData.pos.size();
+				contour_curve_begin = vg.curveData.curveIndex + 1;
 				closed = false;
 				break;
 			case 'L':
@@ -182,6 +206,13 @@ void RVG::parse_paths(std::ifstream& fin)
 				vg.addCurve(CurveType::LINE, p);
 				p[0] = p[1];
 				break;
+			case 'Q':
+				p[1] = read_point();
+				p[2] = read_point();
+				vg.newCurve();
+				vg.addCurve(CurveType::QUADRIC, p);
+				p[0] = p[2];
+				break;
 			case 'C':
 				p[1] = read_point();
 				p[2] = read_point();
@@ -193,6 +224,17 @@ void RVG::parse_paths(std::ifstream& fin)
 			case 'Z':
 				closed = true;
 				break;
+			case 'A': {
+				// rational quadratic: homogeneous control point "x,y,w" and end point
+				glm::vec3 h1;
+				fin >> tstr;
+				replace_comma(tstr);
+				sscanf_s(tstr.c_str(), "%f %f %f", &h1.x, &h1.y, &h1.z);
+				p[1] = read_point();
+				vg.addArc(p[0], h1, p[1]);
+				p[0] = p[1];
+				break;
+			}
 			default: 
 				if (tstr == "fL") {
 					p[0] = read_point();
@@ -208,9 +250,9 @@ void RVG::parse_paths(std::ifstream& fin)
 		//}
 
 		// close path
-		if (!closed && vg.pointData.pos.size() > contour_vertex_begin) {
+		if (!closed && vg.curveData.curveIndex + 1 > contour_curve_begin) {
 			// add a straight line.
-			glm::vec2 p_first = vg.pointData.pos[contour_vertex_begin];
+			glm::vec2 p_first = vg.pointData.pos[vg.curveData.posIndices[contour_curve_begin]];
 			glm::vec2 p_last = vg.pointData.pos.back();
 
 			if (p_first != p_last) {
@@ -222,7 +264,15 @@ void RVG::parse_paths(std::ifstream& fin)
 
 		}
 
-		assert(tstr == "dyn_identity");
+		// path transform
+		assert(tstr == "dyn_identity" || tstr.substr(0, 10) == "dyn_affine");
+		glm::mat3x2& m = vg.pathData.transform[pathInd];
+		m = glm::mat3x2(1.0f);
+		if (tstr != "dyn_identity") {
+			// dyn_affine([a,b,c],[d,e,f]): x' = a*x + b*y + c, y' = d*x + e*y + f
+			sscanf_s(tstr.c_str(), "dyn_affine([%f,%f,%f],[%f,%f,%f])"
+				, &m[0][0], &m[1][0], &m[2][0], &m[0][1], &m[1][1], &m[2][1]);
+		}
 		fin >> tstr;
 		assert(tstr == "dyn_paint");
 		
@@ -249,9 +299,370 @@ void RVG::parse_paths(std::ifstream& fin)
 				iss >> color.r >> color.g >> color.b;
 			}
 		}
+		else {
+			// gradient paints are not supported yet, drop the rest of the record
+			getline(fin, tstr);
+		}
 		//printf("path idx %d end\n", vg.pathData.pathIndex);
 
 	}
 }
 
+// dyn_affine([a,b,c],[d,e,f]): x' = a*x + b*y + c, y' = d*x + e*y + f
+static glm::mat3x2 parseAffine(std::string_view tstr)
+{
+	const char* cur = tstr.data();
+	const char* end = tstr.data() + tstr.size();
+	float v[6] = { 1, 0, 0, 0, 1, 0 };
+	for (int i = 0; i < 6; ++i) {
+		while (cur < end && std::string_view("-+.0123456789").find(*cur) == std::string_view::npos) { ++cur; }
+		if (cur == end) {
+			break;
+		}
+		v[i] = RVGTokenizer::scanFloat(cur, end);
+	}
+	glm::mat3x2 m;
+	m[0] = glm::vec2(v[0], v[3]);
+	m[1] = glm::vec2(v[1], v[4]);
+	m[2] = glm::vec2(v[2], v[5]);
+	return m;
+}
+
+void RVG::parse_header(RVGTokenizer& tk)
+{
+	auto& vg = *_vgContainer;
+
+	glm::vec2 xy, zw;
+
+	// viewport
+	tk.token();
+	xy = tk.point();
+	zw = tk.point();
+	vg.vp = glm::vec4(xy, zw);
+
+	// window
+	tk.token();
+	xy = tk.point();
+	zw = tk.point();
+	vg.win = glm::vec4(xy, zw);
+
+	std::string_view tstr = tk.token();
+	assert(tstr == "scene");
+
+	tstr = tk.token();
+	assert(tstr == "dyn_identity");
+}
+
+/*
+* Same grammar as parse_paths(std::ifstream&), but every token is a view
+* into the mapped file and points are scanned in place.
+*/
+void RVG::parse_paths(RVGTokenizer& tk, VGContainer& vg)
+{
+	std::string_view tstr;
+	// an already open path in 'vg' is reused by the first record
+	size_t last_path_vertex_number = vg.pathData.pathIndex >= 0 ? vg.pointData.pos.size() : static_cast<size_t>(-1);
+
+	// process each path loop
+	while (!tk.eof()) {
+		tstr = tk.token();
+
+		// process header
+		if (tstr.size() >= 2 && tstr[0] == '/' && tstr[1] == '/') {
+			// ignore annotation
+			tk.skipLine();
+			continue;
+		}
+		if (last_path_vertex_number != vg.pointData.pos.size()) {
+			last_path_vertex_number = vg.pointData.pos.size();
+			vg.newPath();
+		}
+
+		assert(tstr == "1");
+		tstr = tk.token();
+		assert(tstr == "element");
+
+		auto& pathInd = vg.pathData.pathIndex;
+		// fill rule
+		tstr = tk.token();
+		if (tstr == "ofill") {
+			vg.pathData.fillRule[pathInd] = FillRule::EVEN_ODD;
+		}
+		else if (tstr == "nzfill") {
+			vg.pathData.fillRule[pathInd] = FillRule::NON_ZERO;
+		}
+		else {
+			tk.skipLine();
+			continue;
+		}
+
+		tstr = tk.token();
+		assert(tstr == "dyn_concrete");
+
+		tk.point();
+		tk.point();
+		tk.point();
+
+		glm::vec2 p[4];
+
+		int contour_curve_begin = vg.curveData.curveIndex + 1;
+		bool closed = false;
+
+		// process curve
+		while (!tk.eof()) {
+			tstr = tk.token();
+			bool is_fl = (tstr == "fL");
+			if (!is_fl && tstr.length() != 1) {
+				break;
+			}
+
+			char cmd = tstr[0];
+			if (!is_fl && std::string_view("MmZzLlQqCcAa").find(cmd) == std::string_view::npos) {
+				break;
+			}
+
+			switch (cmd) {
+			case 'M':
+				p[0] = tk.point();
+				contour_curve_begin = vg.curveData.curveIndex + 1;
+				closed = false;
+				break;
+			case 'L':
+				p[1] = tk.point();
+				vg.newCurve();
+				vg.addCurve(CurveType::LINE, p);
+				p[0] = p[1];
+				break;
+			case 'Q':
+				p[1] = tk.point();
+				p[2] = tk.point();
+				vg.newCurve();
+				vg.addCurve(CurveType::QUADRIC, p);
+				p[0] = p[2];
+				break;
+			case 'C':
+				p[1] = tk.point();
+				p[2] = tk.point();
+				p[3] = tk.point();
+				vg.newCurve();
+				vg.addCurve(CurveType::CUBIC, p);
+				p[0] = p[3];
+				break;
+			case 'Z':
+				closed = true;
+				break;
+			case 'A': {
+				// rational quadratic: homogeneous control point "x,y,w" and end point
+				glm::vec3 h1;
+				h1.x = tk.number();
+				h1.y = tk.number();
+				h1.z = tk.number();
+				p[1] = tk.point();
+				vg.addArc(p[0], h1, p[1]);
+				p[0] = p[1];
+				break;
+			}
+			default:
+				if (is_fl) {
+					p[0] = tk.point();
+				}
+				break;
+			}
+		}
+
+		// close path
+		if (!closed && vg.curveData.curveIndex + 1 > contour_curve_begin) {
+			// add a straight line.
+			glm::vec2 p_first = vg.pointData.pos[vg.curveData.posIndices[contour_curve_begin]];
+			glm::vec2 p_last = vg.pointData.pos.back();
+
+			if (p_first != p_last) {
+				vg.newCurve();
+				p[0] = p_last;
+				p[1] = p_first;
+				vg.addCurve(CurveType::LINE, p);
+			}
+		}
+
+		// path transform
+		assert(tstr == "dyn_identity" || tstr.substr(0, 10) == "dyn_affine");
+		vg.pathData.transform[pathInd] = tstr == "dyn_identity" ? glm::mat3x2(1.0f) : parseAffine(tstr);
+		tstr = tk.token();
+		assert(tstr == "dyn_paint");
+
+		vg.pathData.fillOpacity[pathInd] = tk.number();
+
+		tstr = tk.token();
+		if (tstr == "solid") {
+			// rgba(r,g,b,a) or rgb(r,g,b)
+			tstr = tk.token();
+			size_t lp = tstr.find('(');
+			if (lp != std::string_view::npos) {
+				const char* cur = tstr.data() + lp + 1;
+				const char* end = tstr.data() + tstr.size();
+				int n_channels = (lp == 4 && tstr.substr(0, 4) == "rgba") ? 4 : 3;
+				glm::vec4& color = vg.pathData.fillColor[pathInd];
+				for (int i = 0; i < n_channels && cur < end; ++i) {
+					color[i] = RVGTokenizer::scanFloat(cur, end);
+					++cur;
+				}
+			}
+		}
+		else {
+			// gradient paints are not supported yet, drop the rest of the record
+			tk.skipLine();
+		}
+	}
+}
+
+// whether [begin, end) holds anything but comments
+static bool hasRecord(const char* begin, const char* end)
+{
+	RVGTokenizer tk(begin, end);
+	while (!tk.eof()) {
+		std::string_view tstr = tk.token();
+		if (tstr.substr(0, 2) != "//") {
+			return true;
+		}
+		tk.skipLine();
+	}
+	return false;
+}
+
+/*
+* Every element record sits on its own line, so the path section is cut at
+* line boundaries, each chunk is parsed into a local container and the
+* chunks are stitched together with prefix sums over their point, curve
+* and path counts.
+*/
+void RVG::parse_paths_parallel(const char* begin, const char* end)
+{
+	const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+	auto& pool = ThreadPool::shared();
+	size_t n_chunks = _parseThreads > 0 ? static_cast<size_t>(_parseThreads) : pool.size();
+	n_chunks = std::max<size_t>(1, std::min(n_chunks, static_cast<size_t>(end - begin) / MIN_CHUNK_BYTES));
+
+	std::vector<const char*> bounds = { begin };
+	for (size_t i = 1; i < n_chunks; ++i) {
+		const char* p = std::max(begin + (end - begin) * i / n_chunks, bounds.back());
+		while (p < end && *p != '\n') { ++p; }
+		bounds.push_back(p < end ? p + 1 : end);
+	}
+	bounds.push_back(end);
+
+	std::vector<VGContainer> parts(n_chunks);
+	for (auto& part : parts) {
+		part.shareEndpoints = _shareEndpoints;
+	}
+	// every chunk after the first starts with an open placeholder path, the
+	// serial parser would continue the last path of the previous chunk there
+	// if that one is still empty
+	const float UNSET = std::numeric_limits<float>::quiet_NaN();
+	pool.parallelFor(n_chunks, [&](size_t i) {
+		if (i > 0) {
+			parts[i].newPath();
+			parts[i].pathData.fillColor[0] = glm::vec4(UNSET);
+			parts[i].pathData.fillOpacity[0] = UNSET;
+		}
+		RVGTokenizer tk(bounds[i], bounds[i + 1]);
+		parse_paths(tk, parts[i]);
+	});
+
+	auto is_open = [](const VGContainer& part) {
+		return part.pathData.pathIndex >= 0
+			&& part.pathData.curveIndices.back() == static_cast<uint32_t>(part.curveData.curveIndex + 1);
+	};
+	VGContainer* open = is_open(parts[0]) ? &parts[0] : nullptr;
+	for (size_t i = 1; i < n_chunks; ++i) {
+		auto& path = parts[i].pathData;
+		if (open) {
+			// continue the empty path, attributes no record has set are inherited
+			auto& prev = open->pathData;
+			if (std::isnan(path.fillOpacity[0])) {
+				path.fillRule[0] = prev.fillRule.back();
+				path.fillOpacity[0] = prev.fillOpacity.back();
+				path.transform[0] = prev.transform.back();
+			}
+			if (std::isnan(path.fillColor[0].r)) {
+				path.fillColor[0] = prev.fillColor.back();
+			}
+			prev.curveIndices.pop_back();
+			prev.fillRule.pop_back();
+			prev.fillColor.pop_back();
+			prev.fillOpacity.pop_back();
+			prev.transform.pop_back();
+			--prev.pathIndex;
+		}
+		else if (hasRecord(bounds[i], bounds[i + 1])) {
+			// a fresh path
+			if (std::isnan(path.fillOpacity[0])) {
+				path.fillOpacity[0] = 0.0f;
+			}
+			if (std::isnan(path.fillColor[0].r)) {
+				path.fillColor[0] = glm::vec4(0, 0, 0, 1);
+			}
+		}
+		else {
+			// nothing but comments, the placeholder was never used
+			path.curveIndices.clear();
+			path.fillRule.clear();
+			path.fillColor.clear();
+			path.fillOpacity.clear();
+			path.transform.clear();
+			path.pathIndex = -1;
+		}
+		if (is_open(parts[i])) {
+			open = &parts[i];
+		}
+		else if (path.pathIndex >= 0) {
+			open = nullptr;
+		}
+	}
+
+	// prefix sums
+	std::vector<uint32_t> point_off(n_chunks + 1, 0), curve_off(n_chunks + 1, 0), path_off(n_chunks + 1, 0);
+	for (size_t i = 0; i < n_chunks; ++i) {
+		point_off[i + 1] = point_off[i] + static_cast<uint32_t>(parts[i].pointData.pos.size());
+		curve_off[i + 1] = curve_off[i] + static_cast<uint32_t>(parts[i].curveData.curveIndex + 1);
+		path_off[i + 1] = path_off[i] + static_cast<uint32_t>(parts[i].pathData.pathIndex + 1);
+	}
+
+	auto& vg = *_vgContainer;
+	vg.pointData.pos.resize(point_off[n_chunks]);
+	vg.curveData.posIndices.resize(curve_off[n_chunks]);
+	vg.curveData.curveType.resize(curve_off[n_chunks]);
+	vg.curveData.arcWeight.resize(curve_off[n_chunks]);
+	vg.curveData.curveIndex = static_cast<int>(curve_off[n_chunks]) - 1;
+	vg.pathData.curveIndices.resize(path_off[n_chunks]);
+	vg.pathData.fillRule.resize(path_off[n_chunks]);
+	vg.pathData.fillColor.resize(path_off[n_chunks]);
+	vg.pathData.fillOpacity.resize(path_off[n_chunks]);
+	vg.pathData.transform.resize(path_off[n_chunks]);
+	vg.pathData.pathIndex = static_cast<int>(path_off[n_chunks]) - 1;
+
+	pool.parallelFor(n_chunks, [&](size_t i) {
+		auto& part = parts[i];
+
+		std::copy(part.pointData.pos.begin(), part.pointData.pos.end(), vg.pointData.pos.begin() + point_off[i]);
+
+		auto& curve = part.curveData;
+		std::copy(curve.curveType.begin(), curve.curveType.end(), vg.curveData.curveType.begin() + curve_off[i]);
+		std::copy(curve.arcWeight.begin(), curve.arcWeight.end(), vg.curveData.arcWeight.begin() + curve_off[i]);
+		for (size_t ci = 0; ci < curve.posIndices.size(); ++ci) {
+			vg.curveData.posIndices[curve_off[i] + ci] = curve.posIndices[ci] + point_off[i];
+		}
+
+		auto& path = part.pathData;
+		size_t n_paths = path_off[i + 1] - path_off[i];
+		std::copy(path.fillRule.begin(), path.fillRule.begin() + n_paths, vg.pathData.fillRule.begin() + path_off[i]);
+		std::copy(path.fillColor.begin(), path.fillColor.begin() + n_paths, vg.pathData.fillColor.begin() + path_off[i]);
+		std::copy(path.fillOpacity.begin(), path.fillOpacity.begin() + n_paths, vg.pathData.fillOpacity.begin() + path_off[i]);
+		std::copy(path.transform.begin(), path.transform.begin() + n_paths, vg.pathData.transform.begin() + path_off[i]);
+		for (size_t pi = 0; pi < n_paths; ++pi) {
+			vg.pathData.curveIndices[path_off[i] + pi] = path.curveIndices[pi] + curve_off[i];
+		}
+	});
+}
+
 };
\ No newline at end of file
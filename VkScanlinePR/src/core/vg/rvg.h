@@ -9,18 +9,44 @@
 
 namespace Galaxysailing {
 
+class RVGTokenizer;
+
+enum class RVGLoadMode {
+	// std::ifstream token by token
+	STREAM = 0,
+	// memory mapped file, tokenized in place
+	MAPPED = 1,
+	// memory mapped file, element lines parsed in chunks on the thread pool
+	PARALLEL = 2
+};
+
 class RVG {
 public:
-	void load(const std::string& filename);
+	void load(const std::string& filename, RVGLoadMode mode = RVGLoadMode::MAPPED);
 
 	std::shared_ptr<VGContainer> getVGContainer();
 
+	// number of chunks used by RVGLoadMode::PARALLEL, 0: one per pool thread
+	void setParseThreads(int n) { _parseThreads = n; }
+
+	// compact container layout, see VGContainer::shareEndpoints; off by
+	// default, the app and BVG::convert turn it on
+	void setShareEndpoints(bool share) { _shareEndpoints = share; }
+
 private:
 	std::shared_ptr<VGContainer> _vgContainer;
+	int _parseThreads = 0;
+	bool _shareEndpoints = false;
 
 	void parse_header(std::ifstream& fin);
 
 	void parse_paths(std::ifstream& fin);
+
+	void parse_header(RVGTokenizer& tk);
+
+	void parse_paths(RVGTokenizer& tk, VGContainer& vg);
+
+	void parse_paths_parallel(const char* begin, const char* end);
 };
 
 }
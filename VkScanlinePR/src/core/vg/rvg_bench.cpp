@@ -0,0 +1,117 @@
+#include "rvg_bench.h"
+#include "rvg.h"
+
+#include <filesystem>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+namespace Galaxysailing {
+
+static bool sameContainer(const VGContainer& a, const VGContainer& b)
+{
+	return a.vp == b.vp && a.win == b.win
+		&& a.pointData.pos == b.pointData.pos
+		&& a.curveData.posIndices == b.curveData.posIndices
+		&& a.curveData.curveType == b.curveData.curveType
+		&& a.curveData.arcWeight == b.curveData.arcWeight
+		&& a.curveData.curveIndex == b.curveData.curveIndex
+		&& a.pathData.curveIndices == b.pathData.curveIndices
+		&& a.pathData.fillRule == b.pathData.fillRule
+		&& a.pathData.fillColor == b.pathData.fillColor
+		&& a.pathData.fillOpacity == b.pathData.fillOpacity
+		&& a.pathData.transform == b.pathData.transform
+		&& a.pathData.pathIndex == b.pathData.pathIndex;
+}
+
+static double loadTime(const std::string& filename, RVGLoadMode mode, int repeat, std::shared_ptr<VGContainer>& out, int n_threads = 0)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeat; ++i) {
+		RVG rvg;
+		rvg.setParseThreads(n_threads);
+		auto t0 = std::chrono::high_resolution_clock::now();
+		rvg.load(filename, mode);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+		out = rvg.getVGContainer();
+	}
+	return best;
+}
+
+void benchmarkRVGLoad(const std::string& dir, int repeat)
+{
+	namespace fs = std::filesystem;
+
+	std::vector<fs::path> files;
+	for (auto& entry : fs::directory_iterator(dir)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".rvg") {
+			files.push_back(entry.path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	// parallel mode is measured with 1, 2, 4, ... chunks up to the core count
+	std::vector<int> thread_counts;
+	int max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	for (int n = 1; n < max_threads; n *= 2) {
+		thread_counts.push_back(n);
+	}
+	thread_counts.push_back(max_threads);
+
+	struct Result {
+		std::string name;
+		uintmax_t bytes;
+		int n_curves;
+		double stream_ms, mapped_ms;
+		std::vector<double> parallel_ms;
+		bool same;
+	};
+	std::vector<Result> results;
+
+	for (auto& file : files) {
+		std::shared_ptr<VGContainer> stream_vg, mapped_vg, parallel_vg;
+		Result r;
+		r.name = file.filename().string();
+		r.bytes = fs::file_size(file);
+		r.stream_ms = loadTime(file.string(), RVGLoadMode::STREAM, repeat, stream_vg);
+		r.mapped_ms = loadTime(file.string(), RVGLoadMode::MAPPED, repeat, mapped_vg);
+		r.n_curves = mapped_vg->curveData.curveIndex + 1;
+		r.same = sameContainer(*stream_vg, *mapped_vg);
+		for (int n : thread_counts) {
+			r.parallel_ms.push_back(loadTime(file.string(), RVGLoadMode::PARALLEL, repeat, parallel_vg, n));
+			r.same = r.same && sameContainer(*stream_vg, *parallel_vg);
+		}
+		results.push_back(r);
+	}
+
+	double stream_total = 0.0, mapped_total = 0.0;
+	std::vector<double> parallel_total(thread_counts.size(), 0.0);
+	printf("\n%-20s %10s %9s %12s %12s", "file", "bytes", "curves", "stream(ms)", "mapped(ms)");
+	for (int n : thread_counts) {
+		printf("   par-%-3d(ms)", n);
+	}
+	printf(" %8s %6s\n", "speedup", "same");
+	for (auto& r : results) {
+		printf("%-20s %10llu %9d %12.3f %12.3f", r.name.c_str()
+			, static_cast<unsigned long long>(r.bytes), r.n_curves
+			, r.stream_ms, r.mapped_ms);
+		for (size_t i = 0; i < r.parallel_ms.size(); ++i) {
+			printf(" %13.3f", r.parallel_ms[i]);
+			parallel_total[i] += r.parallel_ms[i];
+		}
+		double best = std::min(r.mapped_ms, *std::min_element(r.parallel_ms.begin(), r.parallel_ms.end()));
+		printf(" %7.2fx %6s\n", r.stream_ms / best, r.same ? "yes" : "NO");
+		stream_total += r.stream_ms;
+		mapped_total += r.mapped_ms;
+	}
+	printf("%-20s %10s %9s %12.3f %12.3f", "total", "", "", stream_total, mapped_total);
+	for (double t : parallel_total) {
+		printf(" %13.3f", t);
+	}
+	printf("\n");
+}
+
+}
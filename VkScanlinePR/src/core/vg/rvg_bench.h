@@ -0,0 +1,17 @@
+#pragma once
+#ifndef GALAXYSAILING_RVG_BENCH_H_
+#define GALAXYSAILING_RVG_BENCH_H_
+
+#include <string>
+
+namespace Galaxysailing {
+
+/*
+* Load every .rvg file in 'dir' with each RVGLoadMode, check that the
+* resulting containers are identical and print the best-of-'repeat' times.
+*/
+void benchmarkRVGLoad(const std::string& dir, int repeat = 5);
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef GALAXYSAILING_RVG_TOKENIZER_H_
+#define GALAXYSAILING_RVG_TOKENIZER_H_
+
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+namespace Galaxysailing {
+
+/*
+* In-place tokenizer over a memory mapped RVG file.
+* Tokens are returned as views into the mapped text, numbers are scanned
+* by hand (no locale, no temporary strings).
+*/
+class RVGTokenizer {
+public:
+	RVGTokenizer(const char* begin, const char* end) : _cur(begin), _end(end) {}
+
+	bool eof() {
+		skipBlank();
+		return _cur >= _end;
+	}
+
+	// next whitespace separated token, empty at the end of file
+	std::string_view token() {
+		skipBlank();
+		const char* b = _cur;
+		while (_cur < _end && !isBlank(*_cur)) { ++_cur; }
+		return std::string_view(b, _cur - b);
+	}
+
+	const char* position() const { return _cur; }
+
+	// drop the rest of the current line
+	void skipLine() {
+		while (_cur < _end && *_cur != '\n') { ++_cur; }
+	}
+
+	// number followed by an optional ',' or ':' separator
+	float number() {
+		skipBlank();
+		float v = scanFloat(_cur, _end);
+		if (_cur < _end && (*_cur == ',' || *_cur == ':')) { ++_cur; }
+		return v;
+	}
+
+	// "x,y" or "x,y:"
+	glm::vec2 point() {
+		glm::vec2 v;
+		v.x = number();
+		v.y = number();
+		return v;
+	}
+
+	/*
+	* Scan a decimal floating point number starting at 'cur' and advance it
+	* past the number. Up to 19 significant digits are accumulated in an
+	* integer mantissa which is scaled by an exact power of ten.
+	*/
+	static float scanFloat(const char*& cur, const char* end) {
+		bool neg = false;
+		if (cur < end && (*cur == '-' || *cur == '+')) {
+			neg = (*cur == '-');
+			++cur;
+		}
+
+		uint64_t mantissa = 0;
+		int n_digits = 0;
+		int exp10 = 0;
+		for (; cur < end && isDigit(*cur); ++cur) {
+			if (n_digits < 19) {
+				mantissa = mantissa * 10 + (*cur - '0');
+				if (mantissa) { ++n_digits; }
+			}
+			else {
+				++exp10;
+			}
+		}
+		if (cur < end && *cur == '.') {
+			++cur;
+			for (; cur < end && isDigit(*cur); ++cur) {
+				if (n_digits < 19) {
+					mantissa = mantissa * 10 + (*cur - '0');
+					if (mantissa) { ++n_digits; }
+					--exp10;
+				}
+			}
+		}
+		if (cur < end && (*cur == 'e' || *cur == 'E')) {
+			const char* e = cur + 1;
+			bool eneg = false;
+			if (e < end && (*e == '-' || *e == '+')) {
+				eneg = (*e == '-');
+				++e;
+			}
+			if (e < end && isDigit(*e)) {
+				int ev = 0;
+				for (; e < end && isDigit(*e); ++e) {
+					ev = ev < 10000 ? ev * 10 + (*e - '0') : ev;
+				}
+				exp10 += eneg ? -ev : ev;
+				cur = e;
+			}
+		}
+
+		double v = static_cast<double>(mantissa);
+		if (mantissa != 0 && exp10 != 0) {
+			static const double pow10[] = {
+				1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+			if (exp10 < 0 && exp10 >= -22) {
+				v /= pow10[-exp10];
+			}
+			else if (exp10 > 0 && exp10 <= 22) {
+				v *= pow10[exp10];
+			}
+			else {
+				v *= std::pow(10.0, exp10);
+			}
+		}
+		return static_cast<float>(neg ? -v : v);
+	}
+
+private:
+	static bool isBlank(char c) {
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	static bool isDigit(char c) {
+		return static_cast<unsigned>(c - '0') < 10u;
+	}
+
+	void skipBlank() {
+		while (_cur < _end && isBlank(*_cur)) { ++_cur; }
+	}
+
+	const char* _cur;
+	const char* _end;
+};
+
+}
+
+#endif
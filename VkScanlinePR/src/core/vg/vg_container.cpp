@@ -1,5 +1,129 @@
 #include "vg_container.h"
 
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
 namespace Galaxysailing {
 
-};
\ No newline at end of file
+void VGContainer::addArc(glm::vec2 p0, glm::vec3 h1, glm::vec2 p2)
+{
+	const float MIN_WEIGHT = 0.5f;
+
+	glm::vec2 p[3];
+	glm::vec2 xy(h1.x, h1.y);
+	float w = h1.z;
+	if (w >= MIN_WEIGHT) {
+		p[0] = p0;
+		p[1] = xy / w;
+		p[2] = p2;
+		newCurve();
+		addCurve(CurveType::ARC, p, w);
+	}
+	else if (w > -1.0f) {
+		// de Casteljau in homogeneous space, both halves renormalized to
+		// unit end weights
+		glm::vec2 m = (p0 + 2.0f * xy + p2) / (2.0f + 2.0f * w);
+		float half_w = std::sqrt((1.0f + w) * 0.5f);
+
+		p[0] = p0;
+		p[1] = (p0 + xy) / (1.0f + w);
+		p[2] = m;
+		newCurve();
+		addCurve(CurveType::ARC, p, half_w);
+
+		p[0] = m;
+		p[1] = (xy + p2) / (1.0f + w);
+		p[2] = p2;
+		newCurve();
+		addCurve(CurveType::ARC, p, half_w);
+	}
+	else {
+		// passes through infinity, nothing sensible to fill
+		p[0] = p0;
+		p[1] = p2;
+		newCurve();
+		addCurve(CurveType::LINE, p);
+	}
+}
+
+void VGContainer::buildInstances()
+{
+	auto& point = pointData;
+	auto& curve = curveData;
+	auto& path = pathData;
+	auto& inst = instanceData;
+
+	uint32_t n_paths = path.pathIndex + 1;
+	uint32_t n_curves = curve.curveIndex + 1;
+	uint32_t n_points = static_cast<uint32_t>(point.pos.size());
+
+	auto curveBegin = [&](uint32_t pi) { return path.curveIndices[pi]; };
+	auto curveEnd = [&](uint32_t pi) { return pi != n_paths - 1 ? path.curveIndices[pi + 1] : n_curves; };
+	auto pointBegin = [&](uint32_t ci) { return ci != n_curves ? curve.posIndices[ci] : n_points; };
+
+	// FNV-1a over the raw bits, equal hashes are compared in full
+	auto hashBytes = [](uint64_t h, const void* data, size_t bytes) {
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < bytes; ++i) {
+			h = (h ^ p[i]) * 1099511628211ull;
+		}
+		return h;
+	};
+	auto samePath = [&](uint32_t a, uint32_t b) {
+		uint32_t ca = curveBegin(a), cb = curveBegin(b);
+		uint32_t nc = curveEnd(a) - ca;
+		if (nc != curveEnd(b) - cb) {
+			return false;
+		}
+		uint32_t pa = pointBegin(ca), pb = pointBegin(cb);
+		uint32_t np = pointBegin(ca + nc) - pa;
+		if (np != pointBegin(cb + nc) - pb) {
+			return false;
+		}
+		for (uint32_t i = 0; i < nc; ++i) {
+			if (curve.curveType[ca + i] != curve.curveType[cb + i]
+				|| curve.arcWeight[ca + i] != curve.arcWeight[cb + i]
+				|| curve.posIndices[ca + i] - pa != curve.posIndices[cb + i] - pb) {
+				return false;
+			}
+		}
+		return np == 0 || memcmp(&point.pos[pa], &point.pos[pb], np * sizeof(glm::vec2)) == 0;
+	};
+
+	inst.pathGeometry.clear();
+	inst.geometryPath.clear();
+	inst.pathGeometry.reserve(n_paths);
+
+	std::unordered_multimap<uint64_t, uint32_t> geometries;
+	geometries.reserve(n_paths);
+	for (uint32_t pi = 0; pi < n_paths; ++pi) {
+		uint32_t cb = curveBegin(pi), ce = curveEnd(pi);
+		uint32_t pb = pointBegin(cb), pe = pointBegin(ce);
+
+		uint64_t h = 14695981039346656037ull;
+		if (ce > cb) {
+			h = hashBytes(h, &curve.curveType[cb], (ce - cb) * sizeof(CurveType));
+			h = hashBytes(h, &curve.arcWeight[cb], (ce - cb) * sizeof(float));
+		}
+		if (pe > pb) {
+			h = hashBytes(h, &point.pos[pb], (pe - pb) * sizeof(glm::vec2));
+		}
+
+		uint32_t geometry = static_cast<uint32_t>(inst.geometryPath.size());
+		auto range = geometries.equal_range(h);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (samePath(inst.geometryPath[it->second], pi)) {
+				geometry = it->second;
+				break;
+			}
+		}
+		if (geometry == inst.geometryPath.size()) {
+			inst.geometryPath.push_back(pi);
+			geometries.emplace(h, geometry);
+		}
+		inst.pathGeometry.push_back(geometry);
+	}
+}
+
+};
@@ -4,16 +4,17 @@
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <cstdint>
 namespace Galaxysailing {
 
-enum class CurveType {
+enum class CurveType : uint8_t {
 	NONE = 0x00,
 	LINE = 0x02,
 	QUADRIC = 0x03,
 	CUBIC = 0x04,
 	ARC = 0x13
 };
-enum class FillRule {
+enum class FillRule : uint8_t {
 	NON_ZERO = 0,
 	EVEN_ODD = 1
 };
@@ -23,6 +24,15 @@ public:
 	glm::vec4 vp;
 	glm::vec4 win;
 
+	/*
+	* Compact layout: a curve starting on the last stored point of its
+	* path reuses that point, so on a contour every vertex is stored once.
+	* Curve i still reads its (curveType & 7) points from posIndices[i]
+	* on, only the shared point is also the previous curve's end point.
+	* Off unless the loader asks for it, see RVG::setShareEndpoints.
+	*/
+	bool shareEndpoints = false;
+
 	struct PointData {
 		std::vector<glm::vec2> pos;
 	};
@@ -30,6 +40,8 @@ public:
 	struct CurveData {
 		std::vector<uint32_t> posIndices;
 		std::vector<CurveType> curveType;
+		// middle weight of a rational quadratic (ARC), 0 for other curves
+		std::vector<float> arcWeight;
 		int curveIndex = -1;
 	};
 	
@@ -39,12 +51,26 @@ public:
 		std::vector<FillRule> fillRule;
 		std::vector<glm::vec4> fillColor;
 		std::vector<float> fillOpacity;
+		// dyn_affine of the element: p' = transform * vec3(p, 1)
+		std::vector<glm::mat3x2> transform;
 		int pathIndex = -1;
 	};
 
+	/*
+	* Paths sharing identical curves (types, weights and points before
+	* their dyn_affine) are instances of one geometry. Geometry g is
+	* stored by the curves of path geometryPath[g], the per-path transform
+	* and paint stay in PathData. Empty until buildInstances().
+	*/
+	struct InstanceData {
+		std::vector<uint32_t> pathGeometry;
+		std::vector<uint32_t> geometryPath;
+	};
+
 	PathData pathData;
 	CurveData curveData;
 	PointData pointData;
+	InstanceData instanceData;
 public:
 	void newPath() {
 		++pathData.pathIndex;
@@ -52,6 +78,7 @@ public:
 		pathData.fillRule.push_back(FillRule::NON_ZERO);
 		pathData.fillColor.push_back(glm::vec4(0, 0, 0, 1));
 		pathData.fillOpacity.push_back(0.0f);
+		pathData.transform.push_back(glm::mat3x2(1.0f));
 
 	}
 
@@ -59,30 +86,49 @@ public:
 		++curveData.curveIndex;
 		curveData.posIndices.push_back(pointData.pos.size());
 		curveData.curveType.push_back(CurveType::NONE);
+		curveData.arcWeight.push_back(0.0f);
 	}
 
 public:
 
-	void addCurve(CurveType ct, glm::vec2 *p) {
+	// ARC: p[0], p[2] are the end points, p[1] the cartesian control point
+	// and 'w' its weight
+	void addCurve(CurveType ct, glm::vec2 *p, float w = 0.0f) {
 		auto& curInd = curveData.curveIndex;
 		curveData.curveType[curInd] = ct;
-		switch (ct) {
-		case CurveType::LINE:
-			pointData.pos.push_back(p[0]);
-			pointData.pos.push_back(p[1]);
-			break;
-		case CurveType::QUADRIC:
-			break;
-		case CurveType::CUBIC:
-			pointData.pos.push_back(p[0]);
-			pointData.pos.push_back(p[1]);
-			pointData.pos.push_back(p[2]);
-			pointData.pos.push_back(p[3]);
-			break;
-		case CurveType::ARC:
-			break;
-		default: break;
+		if (ct == CurveType::NONE) {
+			return;
+		}
+		if (ct == CurveType::ARC) {
+			curveData.arcWeight[curInd] = w;
+		}
+
+		int first = 0;
+		if (shareEndpoints && pathData.pathIndex >= 0
+			&& curveData.posIndices[pathData.curveIndices.back()] < pointData.pos.size()
+			&& pointData.pos.back() == p[0]) {
+			--curveData.posIndices[curInd];
+			first = 1;
 		}
+		int n = static_cast<int>(ct) & 7;
+		for (int i = first; i < n; ++i) {
+			pointData.pos.push_back(p[i]);
+		}
+	}
+
+	/*
+	* Rational quadratic from 'p0' to 'p2' with the homogeneous control
+	* point 'h1' = (x, y, w). Small or zero weights (the control point is
+	* far away or at infinity) are split once at t = 0.5, so every stored
+	* ARC has a cartesian control point and a weight >= sqrt(0.5).
+	*/
+	void addArc(glm::vec2 p0, glm::vec3 h1, glm::vec2 p2);
+
+	// deduplicate identical paths into instanceData
+	void buildInstances();
+
+	bool hasInstances() const {
+		return instanceData.pathGeometry.size() == static_cast<size_t>(pathData.pathIndex + 1);
 	}
 };
 
@@ -0,0 +1,212 @@
+#include "vg_scene.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include "../common/thread_pool.h"
+
+namespace Galaxysailing {
+
+template<class T>
+static VGSpan<T> spanOf(const std::vector<T>& v)
+{
+	VGSpan<T> s;
+	s.data = v.data();
+	s.size = static_cast<uint32_t>(v.size());
+	return s;
+}
+
+// below this many curves per chunk the pool overhead outweighs the copy
+static const uint32_t MIN_CHUNK_CURVES = 1 << 14;
+static const uint32_t MIN_CHUNK_PATHS = 1 << 12;
+
+static double msSince(std::chrono::high_resolution_clock::time_point t0)
+{
+	auto t1 = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+static uint32_t chunkCount(uint32_t n, uint32_t min_chunk, size_t n_threads)
+{
+	uint32_t max_chunks = static_cast<uint32_t>(n_threads * 4);
+	return std::max(1u, std::min(max_chunks, n / min_chunk));
+}
+
+void VGScene::assign(const VGContainer& vg)
+{
+	auto& point = vg.pointData;
+	auto& curve = vg.curveData;
+	auto& path = vg.pathData;
+	auto& inst = vg.instanceData;
+
+	ThreadPool& pool = ThreadPool::shared();
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	vp = vg.vp;
+	win = vg.win;
+
+	n_paths = path.pathIndex + 1;
+	uint32_t vg_curves = curve.curveIndex + 1;
+	uint32_t vg_points = static_cast<uint32_t>(point.pos.size());
+
+	bool instanced = vg.hasInstances();
+	n_geometries = instanced ? static_cast<uint32_t>(inst.geometryPath.size()) : n_paths;
+
+	auto geometryPath = [&](uint32_t gi) { return instanced ? inst.geometryPath[gi] : gi; };
+	auto curveEnd = [&](uint32_t pi) { return pi != n_paths - 1 ? path.curveIndices[pi + 1] : vg_curves; };
+	// a curve sharing its start with the previous end or storing nothing
+	// owns fewer points than its type has
+	auto pointBegin = [&](uint32_t ci) { return curve.posIndices[ci]; };
+	auto pointCount = [&](uint32_t ci) {
+		uint32_t point_end = (ci != vg_curves - 1 ? curve.posIndices[ci + 1] : vg_points);
+		return point_end > curve.posIndices[ci] ? point_end - curve.posIndices[ci] : 0u;
+	};
+
+	// geometry curve offsets follow from the path curve offsets
+	geometry_curve_begin.resize(n_geometries + 1);
+	uint32_t n_geometry_curves = 0;
+	for (uint32_t gi = 0; gi < n_geometries; ++gi) {
+		uint32_t pi = geometryPath(gi);
+		geometry_curve_begin[gi] = n_geometry_curves;
+		n_geometry_curves += curveEnd(pi) - path.curveIndices[pi];
+	}
+	geometry_curve_begin[n_geometries] = n_geometry_curves;
+
+	// the curves are split evenly into chunks, a chunk may start inside a
+	// geometry. fn(gi, oc, ci): output curve 'oc' of geometry 'gi' is
+	// source curve 'ci'
+	uint32_t n_chunks = chunkCount(n_geometry_curves, MIN_CHUNK_CURVES, pool.size());
+	auto chunkBegin = [&](size_t c) {
+		return static_cast<uint32_t>(static_cast<uint64_t>(n_geometry_curves) * c / n_chunks);
+	};
+	auto forChunk = [&](size_t c, auto&& fn) {
+		uint32_t begin = chunkBegin(c);
+		uint32_t end = chunkBegin(c + 1);
+		uint32_t gi = static_cast<uint32_t>(std::upper_bound(geometry_curve_begin.begin()
+			, geometry_curve_begin.end(), begin) - geometry_curve_begin.begin()) - 1;
+		for (uint32_t oc = begin; oc < end; ++oc) {
+			while (geometry_curve_begin[gi + 1] <= oc) {
+				++gi;
+			}
+			uint32_t pi = geometryPath(gi);
+			fn(gi, oc, path.curveIndices[pi] + (oc - geometry_curve_begin[gi]));
+		}
+	};
+	timing.layout_ms = msSince(t0);
+
+	// point offsets need a prefix sum over the chunks
+	t0 = std::chrono::high_resolution_clock::now();
+	std::vector<uint32_t> chunk_point_begin(n_chunks + 1, 0);
+	pool.parallelFor(n_chunks, [&](size_t c) {
+		uint32_t n = 0;
+		forChunk(c, [&](uint32_t, uint32_t, uint32_t ci) { n += pointCount(ci); });
+		chunk_point_begin[c + 1] = n;
+	});
+	for (uint32_t c = 0; c < n_chunks; ++c) {
+		chunk_point_begin[c + 1] += chunk_point_begin[c];
+	}
+	uint32_t n_geometry_points = chunk_point_begin[n_chunks];
+	timing.count_ms = msSince(t0);
+
+	// every chunk writes its own range of the presized arrays
+	t0 = std::chrono::high_resolution_clock::now();
+	position.resize(n_geometry_points);
+	curve_position_map.resize(n_geometry_curves);
+	curve_type.assign(vgPackedBytes(n_geometry_curves), 0);
+	curve_arc_w.resize(n_geometry_curves);
+	geometry_point_begin.resize(n_geometries + 1);
+	pool.parallelFor(n_chunks, [&](size_t c) {
+		uint32_t poi = chunk_point_begin[c];
+		forChunk(c, [&](uint32_t gi, uint32_t oc, uint32_t ci) {
+			if (oc == geometry_curve_begin[gi]) {
+				geometry_point_begin[gi] = poi;
+			}
+			curve_position_map[oc] = poi;
+			curve_type[oc] = static_cast<uint8_t>(curve.curveType[ci]);
+			curve_arc_w[oc] = curve.arcWeight[ci];
+			uint32_t n = pointCount(ci);
+			std::copy_n(point.pos.begin() + pointBegin(ci), n, position.begin() + poi);
+			poi += n;
+		});
+	});
+	// empty geometries start where the next one does
+	geometry_point_begin[n_geometries] = n_geometry_points;
+	for (uint32_t gi = n_geometries; gi-- > 0;) {
+		if (geometry_curve_begin[gi] == geometry_curve_begin[gi + 1]) {
+			geometry_point_begin[gi] = geometry_point_begin[gi + 1];
+		}
+	}
+	timing.geometry_ms = msSince(t0);
+
+	// path
+	t0 = std::chrono::high_resolution_clock::now();
+	path_geometry.resize(n_paths);
+	path_point_begin.resize(n_paths + 1);
+	path_curve_begin.resize(n_paths + 1);
+	fill_rule.assign(vgPackedBytes(n_paths), 0);
+	fill_info.resize(n_paths);
+	path_transform.resize(n_paths);
+
+	n_points = 0;
+	n_curves = 0;
+	for (uint32_t pi = 0; pi < n_paths; ++pi) {
+		uint32_t geometry = instanced ? inst.pathGeometry[pi] : pi;
+		path_geometry[pi] = geometry;
+		path_point_begin[pi] = n_points;
+		path_curve_begin[pi] = n_curves;
+		n_points += geometry_point_begin[geometry + 1] - geometry_point_begin[geometry];
+		n_curves += geometry_curve_begin[geometry + 1] - geometry_curve_begin[geometry];
+	}
+	path_point_begin[n_paths] = n_points;
+	path_curve_begin[n_paths] = n_curves;
+
+	uint32_t n_path_chunks = chunkCount(n_paths, MIN_CHUNK_PATHS, pool.size());
+	pool.parallelFor(n_path_chunks, [&](size_t c) {
+		uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(n_paths) * c / n_path_chunks);
+		uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(n_paths) * (c + 1) / n_path_chunks);
+		for (uint32_t pi = begin; pi < end; ++pi) {
+			// process fill color
+			glm::vec4 color = path.fillColor[pi];
+			color.a *= path.fillOpacity[pi];
+			color *= 255.0f;
+			uint8_t col[4];
+			for (int i = 0; i < 4; ++i) {
+				col[i] = static_cast<uint8_t>(color[i]);
+			}
+			uint32_t rgba = *((uint32_t*)col);
+			fill_info[pi] = rgba & 0xFF000000 ? rgba : 0;
+
+			// process fill rule
+			fill_rule[pi] = static_cast<uint8_t>(path.fillRule[pi]);
+
+			path_transform[pi] = path.transform[pi];
+		}
+	});
+	timing.path_ms = msSince(t0);
+}
+
+VGSceneView VGScene::view() const
+{
+	VGSceneView v;
+	v.vp = vp;
+	v.win = win;
+	v.position = spanOf(position);
+	v.curve_position_map = spanOf(curve_position_map);
+	v.curve_type = spanOf(curve_type);
+	v.curve_arc_w = spanOf(curve_arc_w);
+	v.geometry_point_begin = spanOf(geometry_point_begin);
+	v.geometry_curve_begin = spanOf(geometry_curve_begin);
+	v.path_geometry = spanOf(path_geometry);
+	v.path_point_begin = spanOf(path_point_begin);
+	v.path_curve_begin = spanOf(path_curve_begin);
+	v.fill_rule = spanOf(fill_rule);
+	v.fill_info = spanOf(fill_info);
+	v.path_transform = spanOf(path_transform);
+	v.n_points = n_points;
+	v.n_curves = n_curves;
+	v.n_paths = n_paths;
+	v.n_geometries = n_geometries;
+	return v;
+}
+
+}
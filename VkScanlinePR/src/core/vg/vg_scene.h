@@ -0,0 +1,125 @@
+#pragma once
+#ifndef GALAXYSAILING_VG_SCENE_H_
+#define GALAXYSAILING_VG_SCENE_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "vg_container.h"
+
+namespace Galaxysailing {
+
+// byte arrays are zero padded to whole 32-bit words for the shaders
+inline uint32_t vgPackedBytes(uint32_t n)
+{
+	return (n + 3) & ~3u;
+}
+
+template<class T>
+struct VGSpan {
+	const T* data = nullptr;
+	uint32_t size = 0;
+};
+
+/*
+* Flattened structure-of-arrays view of a scene, exactly the arrays the
+* scanline rasterizer uploads. The data is owned by a VGScene or by a
+* mapped binary scene file (BVG).
+*
+* Point and curve arrays hold every unique geometry once. Each path is an
+* instance of one geometry with its own transform and paint, the
+* rasterizer expands instances to n_points / n_curves on the GPU.
+*/
+struct VGSceneView {
+	glm::vec4 vp;
+	glm::vec4 win;
+
+	// point
+	VGSpan<glm::vec2> position;
+
+	// curve, 'curve_position_map' indexes 'position'
+	VGSpan<uint32_t> curve_position_map;
+	// one byte per curve, see vgPackedBytes
+	VGSpan<uint8_t> curve_type;
+	VGSpan<float> curve_arc_w;
+
+	// geometry, n_geometries + 1 prefix offsets
+	VGSpan<uint32_t> geometry_point_begin;
+	VGSpan<uint32_t> geometry_curve_begin;
+
+	// path (instance)
+	VGSpan<uint32_t> path_geometry;
+	// n_paths + 1 prefix offsets into the expanded points / curves
+	VGSpan<uint32_t> path_point_begin;
+	VGSpan<uint32_t> path_curve_begin;
+	// one byte per path, see vgPackedBytes
+	VGSpan<uint8_t> fill_rule;
+	VGSpan<uint32_t> fill_info;
+	VGSpan<glm::mat3x2> path_transform;
+
+	// expanded counts
+	uint32_t n_points = 0;
+	uint32_t n_curves = 0;
+	uint32_t n_paths = 0;
+	uint32_t n_geometries = 0;
+};
+
+// wall time of the VGScene::assign stages
+struct VGSceneTiming {
+	// geometry curve offsets and chunking
+	double layout_ms = 0.0;
+	// per chunk point counts and their prefix sum
+	double count_ms = 0.0;
+	// parallel copy of points and curves
+	double geometry_ms = 0.0;
+	// path offsets, packed paint, fill rules and transforms
+	double path_ms = 0.0;
+
+	double total_ms() const { return layout_ms + count_ms + geometry_ms + path_ms; }
+};
+
+class VGScene {
+public:
+	VGScene() {}
+	explicit VGScene(const VGContainer& vg) { assign(vg); }
+
+	// flatten 'vg' geometry by geometry, every path without instanceData
+	// is its own geometry. Fill color and opacity are packed to rgba8.
+	// Points and curves are copied in parallel on ThreadPool::shared()
+	void assign(const VGContainer& vg);
+
+	VGSceneView view() const;
+
+public:
+	glm::vec4 vp;
+	glm::vec4 win;
+
+	std::vector<glm::vec2> position;
+
+	std::vector<uint32_t> curve_position_map;
+	std::vector<uint8_t> curve_type;
+	std::vector<float> curve_arc_w;
+
+	std::vector<uint32_t> geometry_point_begin;
+	std::vector<uint32_t> geometry_curve_begin;
+
+	std::vector<uint32_t> path_geometry;
+	std::vector<uint32_t> path_point_begin;
+	std::vector<uint32_t> path_curve_begin;
+	std::vector<uint8_t> fill_rule;
+	std::vector<uint32_t> fill_info;
+	std::vector<glm::mat3x2> path_transform;
+
+	uint32_t n_points = 0;
+	uint32_t n_curves = 0;
+	uint32_t n_paths = 0;
+	uint32_t n_geometries = 0;
+
+	VGSceneTiming timing;
+};
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "vg_simplify.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Galaxysailing {
+
+namespace {
+
+struct Curve {
+	CurveType type;
+	glm::vec2 p[4];
+	float w;
+
+	int n() const { return static_cast<int>(type) & 7; }
+	glm::vec2& end() { return p[n() - 1]; }
+};
+
+}
+
+// distance from 'p' to the segment [a, b]
+static float segmentDistance(glm::vec2 p, glm::vec2 a, glm::vec2 b)
+{
+	glm::vec2 ab = b - a;
+	float len2 = glm::dot(ab, ab);
+	float t = len2 > 0.0f ? glm::clamp(glm::dot(p - a, ab) / len2, 0.0f, 1.0f) : 0.0f;
+	return glm::length(p - (a + t * ab));
+}
+
+// 'b' continues the axis-aligned run a -> 'from' -> 'b' in the same direction
+static bool continuesAxisRun(glm::vec2 a, glm::vec2 from, glm::vec2 b)
+{
+	if (a.y == from.y && from.y == b.y) {
+		return (from.x - a.x) * (b.x - from.x) > 0.0f;
+	}
+	if (a.x == from.x && from.x == b.x) {
+		return (from.y - a.y) * (b.y - from.y) > 0.0f;
+	}
+	return false;
+}
+
+static void simplifyContour(const Curve* in, size_t n_in, float tol, bool lossy
+	, std::vector<Curve>& out, VGSimplifyStats& counts)
+{
+	// joining a run re-checks every vertex of it
+	const size_t MAX_RUN = 64;
+	// exact mode only drops curves of one point
+	const float step = lossy ? tol / 3.0f : 0.0f;
+
+	glm::vec2 finish = in[n_in - 1].p[in[n_in - 1].n() - 1];
+
+	// drop degenerate curves and demote flat ones, a curve after a dropped
+	// one starts where the last kept curve ended
+	std::vector<Curve> kept;
+	kept.reserve(n_in);
+	glm::vec2 cur = in[0].p[0];
+	for (size_t i = 0; i < n_in; ++i) {
+		Curve c = in[i];
+		int n = c.n();
+		c.p[0] = cur;
+
+		bool degenerate = true;
+		for (int k = 1; k < n; ++k) {
+			degenerate = degenerate && (lossy ? glm::length(c.p[k] - cur) <= step : c.p[k] == cur);
+		}
+		if (degenerate) {
+			++counts.degenerate;
+			continue;
+		}
+
+		if (lossy && c.type != CurveType::LINE) {
+			// the curve stays inside the hull of its control points
+			float dev = 0.0f;
+			for (int k = 1; k < n - 1; ++k) {
+				dev = std::max(dev, segmentDistance(c.p[k], c.p[0], c.p[n - 1]));
+			}
+			if (dev <= step) {
+				c.p[1] = c.p[n - 1];
+				c.type = CurveType::LINE;
+				c.w = 0.0f;
+				++counts.demoted;
+			}
+		}
+		kept.push_back(c);
+		cur = c.end();
+	}
+	if (kept.empty()) {
+		return;
+	}
+	// trailing curves were dropped, end exactly where the contour ended
+	kept.back().end() = finish;
+
+	// join runs of lines that stay within 'step' of one chord, or in exact
+	// mode that stay on one horizontal or vertical in one direction
+	for (size_t i = 0; i < kept.size();) {
+		if (kept[i].type != CurveType::LINE) {
+			out.push_back(kept[i++]);
+			continue;
+		}
+		glm::vec2 a = kept[i].p[0];
+		size_t j = i + 1;
+		while (j < kept.size() && j - i < MAX_RUN && kept[j].type == CurveType::LINE) {
+			glm::vec2 b = kept[j].p[1];
+			bool flat = true;
+			if (!lossy) {
+				flat = continuesAxisRun(a, kept[j].p[0], b);
+			}
+			for (size_t k = i; k < j && flat && lossy; ++k) {
+				flat = segmentDistance(kept[k].p[1], a, b) <= step;
+			}
+			if (!flat) {
+				break;
+			}
+			++j;
+		}
+		Curve c = kept[i];
+		c.p[1] = kept[j - 1].p[1];
+		counts.merged += static_cast<int>(j - i - 1);
+		out.push_back(c);
+		i = j;
+	}
+}
+
+std::shared_ptr<VGContainer> simplifyVG(const VGContainer& vg
+	, const VGSimplifyOptions& options
+	, VGSimplifyStats* stats)
+{
+	auto& point = vg.pointData;
+	auto& curve = vg.curveData;
+	auto& path = vg.pathData;
+
+	uint32_t n_paths = path.pathIndex + 1;
+	uint32_t n_curves = curve.curveIndex + 1;
+
+	bool instanced = vg.hasInstances();
+	uint32_t n_geometries = instanced ? static_cast<uint32_t>(vg.instanceData.geometryPath.size()) : n_paths;
+	auto geometryOf = [&](uint32_t pi) { return instanced ? vg.instanceData.pathGeometry[pi] : pi; };
+
+	// tolerance in path space, the tightest over the instances of a geometry
+	std::vector<float> tol(n_geometries, std::numeric_limits<float>::infinity());
+	for (uint32_t pi = 0; pi < n_paths; ++pi) {
+		const glm::mat3x2& m = path.transform[pi];
+		float scale = std::sqrt(glm::dot(m[0], m[0]) + glm::dot(m[1], m[1])) * options.max_zoom;
+		float t = options.pixel_tolerance / scale;
+		auto& g = tol[geometryOf(pi)];
+		g = std::min(g, std::isfinite(t) ? t : 0.0f);
+	}
+
+	std::vector<std::vector<Curve>> geometries(n_geometries);
+	std::vector<VGSimplifyStats> geometry_counts(n_geometries);
+	std::vector<Curve> in;
+	for (uint32_t gi = 0; gi < n_geometries; ++gi) {
+		uint32_t pi = instanced ? vg.instanceData.geometryPath[gi] : gi;
+		uint32_t curve_begin = path.curveIndices[pi];
+		uint32_t curve_end = (pi != n_paths - 1 ? path.curveIndices[pi + 1] : n_curves);
+
+		in.clear();
+		for (uint32_t ci = curve_begin; ci < curve_end; ++ci) {
+			Curve c;
+			c.type = curve.curveType[ci];
+			c.w = curve.arcWeight[ci];
+			if (c.n() == 0) {
+				continue;
+			}
+			for (int k = 0; k < c.n(); ++k) {
+				c.p[k] = point.pos[curve.posIndices[ci] + k];
+			}
+			in.push_back(c);
+		}
+
+		// a contour is a run of curves each starting where the last ended
+		auto& out = geometries[gi];
+		size_t contour = 0;
+		for (size_t i = 1; i <= in.size(); ++i) {
+			if (i == in.size() || in[i].p[0] != in[i - 1].end()) {
+				simplifyContour(&in[contour], i - contour, tol[gi], options.lossy, out, geometry_counts[gi]);
+				contour = i;
+			}
+		}
+		geometry_counts[gi].curves_before = static_cast<int>(in.size());
+		geometry_counts[gi].curves_after = static_cast<int>(out.size());
+	}
+
+	auto res = std::make_shared<VGContainer>();
+	res->vp = vg.vp;
+	res->win = vg.win;
+	res->shareEndpoints = vg.shareEndpoints;
+
+	VGSimplifyStats total;
+	for (uint32_t pi = 0; pi < n_paths; ++pi) {
+		res->newPath();
+		res->pathData.fillRule[pi] = path.fillRule[pi];
+		res->pathData.fillColor[pi] = path.fillColor[pi];
+		res->pathData.fillOpacity[pi] = path.fillOpacity[pi];
+		res->pathData.transform[pi] = path.transform[pi];
+
+		uint32_t gi = geometryOf(pi);
+		for (Curve c : geometries[gi]) {
+			res->newCurve();
+			res->addCurve(c.type, c.p, c.w);
+		}
+
+		auto& counts = geometry_counts[gi];
+		total.curves_before += counts.curves_before;
+		total.curves_after += counts.curves_after;
+		total.degenerate += counts.degenerate;
+		total.demoted += counts.demoted;
+		total.merged += counts.merged;
+	}
+	if (instanced) {
+		res->buildInstances();
+	}
+
+	if (stats) {
+		*stats = total;
+	}
+	return res;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef GALAXYSAILING_VG_SIMPLIFY_H_
+#define GALAXYSAILING_VG_SIMPLIFY_H_
+
+#include <memory>
+
+#include "vg_container.h"
+
+namespace Galaxysailing {
+
+struct VGSimplifyOptions {
+	// allow the tolerance-driven steps, outlines may move and pixels
+	// near edges may change; off keeps only the exact steps
+	bool lossy = false;
+	// largest displacement of any outline in lossy mode, in pixels
+	float pixel_tolerance = 1.0f / 32.0f;
+	// largest camera scale the lossy tolerance has to hold at, the camera maps
+	// one document unit to one pixel at zoom 1
+	float max_zoom = 4.0f;
+};
+
+struct VGSimplifyStats {
+	// counted per path, i.e. what the rasterizer sees after instancing
+	int curves_before = 0;
+	int curves_after = 0;
+	// zero-length segments and curves dropped
+	int degenerate = 0;
+	// near-flat quadrics, cubics and arcs turned into lines, lossy only
+	int demoted = 0;
+	// lines removed by joining collinear neighbours
+	int merged = 0;
+};
+
+/*
+* Load-time geometry cleanup between RVG::load and loadVG.
+*
+* By default only steps that leave every scanline crossing bit-identical
+* at any zoom run: segments and curves whose points all equal their
+* start are dropped (they cross no scanline), and runs of lines on one
+* horizontal or one vertical that keep their direction are joined (a
+* horizontal run crosses no scanline, a vertical one crosses at its x,
+* exactly as its pieces did).
+*
+* With 'lossy' set it drops segments shorter than the tolerance, demotes
+* curves whose control points lie within the tolerance of their chord
+* to lines and joins runs of nearly collinear lines instead. Each step
+* gets a third of the tolerance, so no outline moves further than
+* 'pixel_tolerance' pixels at any zoom up to 'max_zoom', but pixels
+* whose samples lie that close to an edge can flip. The tolerance is
+* taken into each path's space through its dyn_affine.
+*
+* Contours stay exactly closed and instances of one geometry stay
+* identical in both modes.
+*/
+std::shared_ptr<VGContainer> simplifyVG(const VGContainer& vg
+	, const VGSimplifyOptions& options = VGSimplifyOptions()
+	, VGSimplifyStats* stats = nullptr);
+
+}
+
+#endif
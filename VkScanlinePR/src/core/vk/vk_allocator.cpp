@@ -0,0 +1,241 @@
+#include "vk_allocator.h"
+#include "vk_util.h"
+#include "vk_initializer.h"
+
+#include <algorithm>
+
+namespace Galaxysailing {
+namespace vk {
+
+	static uint32_t sizeClassOf(VkDeviceSize size)
+	{
+		uint32_t k = 0;
+		while ((MemoryAllocator::MIN_CLASS_SIZE << k) < size)
+		{
+			++k;
+		}
+		return k;
+	}
+
+	MemoryAllocator::MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkDeviceSize blockSize)
+	{
+		_device = device;
+		_memoryProperties = memoryProperties;
+		_blockSize = blockSize;
+		_blockClass = sizeClassOf(blockSize / 2);
+		_types.resize(memoryProperties.memoryTypeCount);
+	}
+
+	MemoryAllocator::~MemoryAllocator()
+	{
+		// ranges still in use are released with their blocks, dedicated
+		// objects still in use belong to buffers that outlive the allocator
+		for (auto& type : _types)
+		{
+			for (auto& block : type.blocks)
+			{
+				freeMemory(block.memory, block.mapped);
+			}
+		}
+	}
+
+	/**
+	* Hand out a range that satisfies 'memReqs' from memory type 'memoryType'
+	*
+	* @note The range is 'allocation->size' bytes, at least memReqs.size. Sub-allocated ranges are
+	* their size class and aligned to it, dedicated objects are memReqs.size rounded to the alignment
+	*/
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& memReqs, uint32_t memoryType, MemoryAllocation* allocation)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		uint32_t k = sizeClassOf(memReqs.size > memReqs.alignment ? memReqs.size : memReqs.alignment);
+		VkDeviceSize classSize = MIN_CLASS_SIZE << k;
+		MemoryType& type = _types[memoryType];
+
+		allocation->size = classSize;
+		allocation->memoryType = memoryType;
+		allocation->sizeClass = k;
+
+		// large classes get their own memory object of the requested size,
+		// rounding them up to a class would waste up to half of it
+		if (k > _blockClass)
+		{
+			allocation->size = (memReqs.size + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+			void* mapped = nullptr;
+			VkResult result = allocateMemory(memoryType, allocation->size, &allocation->memory, &mapped);
+			allocation->offset = 0;
+			allocation->mapped = mapped;
+			return result;
+		}
+
+		Block* target = nullptr;
+		VkDeviceSize offset = 0;
+		for (auto& block : type.blocks)
+		{
+			if (carve(block, classSize, &offset))
+			{
+				target = &block;
+				break;
+			}
+		}
+		if (target == nullptr)
+		{
+			Block block;
+			VkResult result = allocateMemory(memoryType, _blockSize, &block.memory, &block.mapped);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			block.freeRanges.push_back({ 0, _blockSize });
+			type.blocks.push_back(block);
+			target = &type.blocks.back();
+			carve(*target, classSize, &offset);
+		}
+		target->used += classSize;
+
+		allocation->memory = target->memory;
+		allocation->offset = offset;
+		allocation->mapped = target->mapped ? static_cast<char*>(target->mapped) + offset : nullptr;
+		return VK_SUCCESS;
+	}
+
+	/**
+	* First fit of 'classSize' bytes in 'block', aligned to 'classSize'
+	*
+	* @note Classes are powers of two, so a class aligned offset satisfies any smaller alignment
+	*/
+	bool MemoryAllocator::carve(Block& block, VkDeviceSize classSize, VkDeviceSize* offset)
+	{
+		auto& ranges = block.freeRanges;
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			FreeRange range = ranges[i];
+			VkDeviceSize begin = (range.offset + classSize - 1) & ~(classSize - 1);
+			VkDeviceSize end = range.offset + range.size;
+			if (begin + classSize > end)
+			{
+				continue;
+			}
+			// what is left on either side stays free
+			ranges.erase(ranges.begin() + i);
+			if (begin + classSize < end)
+			{
+				ranges.insert(ranges.begin() + i, { begin + classSize, end - begin - classSize });
+			}
+			if (range.offset < begin)
+			{
+				ranges.insert(ranges.begin() + i, { range.offset, begin - range.offset });
+			}
+			*offset = begin;
+			return true;
+		}
+		return false;
+	}
+
+	void MemoryAllocator::free(const MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (allocation.sizeClass > _blockClass)
+		{
+			freeMemory(allocation.memory, allocation.mapped);
+			return;
+		}
+
+		auto& blocks = _types[allocation.memoryType].blocks;
+		auto block = std::find_if(blocks.begin(), blocks.end(), [&](const Block& b) {
+			return b.memory == allocation.memory;
+		});
+		assert(block != blocks.end());
+
+		// insert in offset order, then merge with the neighbours it touches
+		auto& ranges = block->freeRanges;
+		auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const FreeRange& r, VkDeviceSize offset) {
+			return r.offset < offset;
+		});
+		size_t i = next - ranges.begin();
+		ranges.insert(next, { allocation.offset, allocation.size });
+		if (i + 1 < ranges.size() && ranges[i].offset + ranges[i].size == ranges[i + 1].offset)
+		{
+			ranges[i].size += ranges[i + 1].size;
+			ranges.erase(ranges.begin() + i + 1);
+		}
+		if (i > 0 && ranges[i - 1].offset + ranges[i - 1].size == ranges[i].offset)
+		{
+			ranges[i - 1].size += ranges[i].size;
+			ranges.erase(ranges.begin() + i);
+		}
+
+		block->used -= allocation.size;
+		// keep the last block of the type so a lone buffer resizing back
+		// and forth does not reallocate it
+		if (block->used == 0 && blocks.size() > 1)
+		{
+			freeMemory(block->memory, block->mapped);
+			blocks.erase(block);
+		}
+	}
+
+	void MemoryAllocator::trim()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto& type : _types)
+		{
+			auto& blocks = type.blocks;
+			for (size_t i = 0; i < blocks.size();)
+			{
+				if (blocks[i].used == 0)
+				{
+					freeMemory(blocks[i].memory, blocks[i].mapped);
+					blocks.erase(blocks.begin() + i);
+				}
+				else
+				{
+					++i;
+				}
+			}
+		}
+	}
+
+	uint32_t MemoryAllocator::memoryObjectCount() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _memoryObjects;
+	}
+
+	VkResult MemoryAllocator::allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory, void** mapped)
+	{
+		VkMemoryAllocateInfo memAlloc = vk::initializer::memoryAllocateInfo();
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryType;
+		VkResult result = vkAllocateMemory(_device, &memAlloc, nullptr, memory);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
+		++_memoryObjects;
+
+		*mapped = nullptr;
+		if (_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			VK_CHECK_RESULT(vkMapMemory(_device, *memory, 0, VK_WHOLE_SIZE, 0, mapped));
+		}
+		return VK_SUCCESS;
+	}
+
+	void MemoryAllocator::freeMemory(VkDeviceMemory memory, void* mapped)
+	{
+		if (mapped)
+		{
+			vkUnmapMemory(_device, memory);
+		}
+		vkFreeMemory(_device, memory, nullptr);
+		--_memoryObjects;
+	}
+
+}// end of namespace vk
+}// end of namespace Galaxysailing
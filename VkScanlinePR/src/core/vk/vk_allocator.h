@@ -0,0 +1,97 @@
+#pragma once
+#ifndef GALAXYSAILING_VK_ALLOCATOR_H_
+#define GALAXYSAILING_VK_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+namespace Galaxysailing {
+namespace vk {
+
+	/** @brief A range of device memory handed out by MemoryAllocator */
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		/** @brief Size of the range, the request rounded up to its size class, or to its alignment in a dedicated object */
+		VkDeviceSize size = 0;
+		uint32_t memoryType = 0;
+		uint32_t sizeClass = 0;
+		/** @brief Host visible memory stays mapped, points at 'offset' */
+		void* mapped = nullptr;
+	};
+
+	/**
+	* @brief Sub-allocating device memory allocator
+	*
+	* Requests are rounded up to power of two size classes. Classes up to
+	* half a block are carved first fit from large per memory type blocks,
+	* bigger requests get a memory object of their own size. Freed
+	* ranges merge with their free neighbours inside the block, a block
+	* with nothing in use is released unless it is the last of its memory
+	* type, and dedicated objects are released when freed.
+	* Host visible blocks are mapped once for their lifetime.
+	*/
+	class MemoryAllocator
+	{
+	public:
+		MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+		~MemoryAllocator();
+
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		VkResult allocate(const VkMemoryRequirements& memReqs, uint32_t memoryType, MemoryAllocation* allocation);
+		void free(const MemoryAllocation& allocation);
+
+		/** @brief Release every block with nothing in use */
+		void trim();
+
+		/** @brief Number of vkAllocateMemory calls currently alive */
+		uint32_t memoryObjectCount() const;
+
+		static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+		static const VkDeviceSize MIN_CLASS_SIZE = 256;
+
+	private:
+		struct FreeRange
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		struct Block
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			/** @brief Bytes handed out */
+			VkDeviceSize used = 0;
+			void* mapped = nullptr;
+			/** @brief Sorted by offset, neighbours are always merged */
+			std::vector<FreeRange> freeRanges;
+		};
+
+		struct MemoryType
+		{
+			std::vector<Block> blocks;
+		};
+
+		bool carve(Block& block, VkDeviceSize classSize, VkDeviceSize* offset);
+
+		VkResult allocateMemory(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory* memory, void** mapped);
+		void freeMemory(VkDeviceMemory memory, void* mapped);
+
+		VkDevice _device;
+		VkPhysicalDeviceMemoryProperties _memoryProperties;
+		VkDeviceSize _blockSize;
+		uint32_t _blockClass;
+		uint32_t _memoryObjects = 0;
+		std::vector<MemoryType> _types;
+		mutable std::mutex _mutex;
+	};
+
+}// end of namespace vk
+}// end of namespace Galaxysailing
+
+#endif
@@ -49,6 +49,14 @@ namespace vk {
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		for (auto& slot : retired)
+		{
+			for (auto& r : slot)
+			{
+				destroyBuffer(r.first, r.second);
+			}
+		}
+		allocator.reset();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -285,6 +293,8 @@ namespace vk {
 		//commandPool = createCommandPool(queueFamilyIndices.graphics);
 		commandPool = createCommandPool(queueFamilyIndices.compute);
 
+		allocator = std::make_unique<MemoryAllocator>(logicalDevice, memoryProperties);
+
 		return result;
 	}
 
@@ -405,6 +415,82 @@ namespace vk {
 		return buffer->bind();
 	}
 
+	/**
+	* Create a buffer bound to a range of the pooled allocator
+	*
+	* @param usageFlags Usage flag bit mask for the buffer (i.e. index, vertex, uniform buffer)
+	* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+	* @param size Size of the buffer in byes
+	* @param buffer Pointer to the buffer handle acquired by the function
+	* @param allocation Pointer to the memory range acquired by the function, host visible ranges are mapped
+	*
+	* @note Buffers using VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT need their own memory, use the overloads above
+	*
+	* @return VK_SUCCESS if buffer handle and memory have been created
+	*/
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, MemoryAllocation* allocation)
+	{
+		VkBufferCreateInfo bufferCreateInfo = vk::initializer::bufferCreateInfo(usageFlags, size);
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
+		uint32_t memoryType = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+		VK_CHECK_RESULT(allocator->allocate(memReqs, memoryType, allocation));
+
+		return vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset);
+	}
+
+	/**
+	* Destroy a buffer created from the pooled allocator and return its memory range
+	*/
+	void VulkanDevice::destroyBuffer(VkBuffer buffer, const MemoryAllocation& allocation)
+	{
+		if (buffer)
+		{
+			vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		}
+		allocator->free(allocation);
+	}
+
+	/**
+	* Destroy a buffer the frames in flight may still use once they are done with it
+	*
+	* @param buffer Buffer to destroy, may be VK_NULL_HANDLE to only free 'allocation'
+	* @param allocation Memory to return to the allocator
+	*
+	* @note Released by beginFrameSlot() the next time the current frame slot comes around
+	*/
+	void VulkanDevice::retireBuffer(VkBuffer buffer, const MemoryAllocation& allocation)
+	{
+		if (retired.empty())
+		{
+			destroyBuffer(buffer, allocation);
+			return;
+		}
+		retired[frameSlot].push_back(std::make_pair(buffer, allocation));
+	}
+
+	/**
+	* Start recording frame slot 'slot' of 'slotCount'
+	*
+	* @note The caller waited for the frame that last used 'slot', what was retired while it recorded is released here
+	*/
+	void VulkanDevice::beginFrameSlot(uint32_t slot, uint32_t slotCount)
+	{
+		if (retired.size() < slotCount)
+		{
+			retired.resize(slotCount);
+		}
+		frameSlot = slot;
+		for (auto& r : retired[slot])
+		{
+			destroyBuffer(r.first, r.second);
+		}
+		retired[slot].clear();
+	}
+
 	/**
 	* Copy buffer data from src to dst using VkCmdCopyBuffer
 	*
@@ -6,8 +6,11 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <utility>
 
 #include "vk_buffer.h"
+#include "vk_allocator.h"
 #include "vk_util.h"
 #include "vk_initializer.h"
 
@@ -34,8 +37,13 @@ namespace vk {
 		std::vector<std::string> supportedExtensions;
 		/** @brief Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
+		/** @brief Pooled memory behind VulkanBuffer, created with the logical device */
+		std::unique_ptr<MemoryAllocator> allocator;
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
+		/** @brief Buffers and memory retired while each frame slot recorded, see retireBuffer() */
+		std::vector<std::vector<std::pair<VkBuffer, MemoryAllocation>>> retired;
+		uint32_t frameSlot = 0;
 		/** @brief Contains queue family indices */
 		struct
 		{
@@ -54,6 +62,10 @@ namespace vk {
 		VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions, void* pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data = nullptr);
 		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vk::Buffer* buffer, VkDeviceSize size, void* data = nullptr);
+		VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, MemoryAllocation* allocation);
+		void            destroyBuffer(VkBuffer buffer, const MemoryAllocation& allocation);
+		void            retireBuffer(VkBuffer buffer, const MemoryAllocation& allocation);
+		void            beginFrameSlot(uint32_t slot, uint32_t slotCount);
 		void            copyBuffer(vk::Buffer* src, vk::Buffer* dst, VkQueue queue, VkBufferCopy* copyRegion = nullptr);
 		VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 		VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
@@ -0,0 +1,157 @@
+#include "vk_transient_heap.h"
+#include "vk_util.h"
+
+#include <algorithm>
+
+namespace Galaxysailing {
+namespace vk {
+
+	TransientHeap::TransientHeap(VulkanDevice* device, VkMemoryPropertyFlags memoryPropertyFlags)
+	{
+		_device = device;
+		_memoryPropertyFlags = memoryPropertyFlags;
+	}
+
+	TransientHeap::~TransientHeap()
+	{
+		_device->allocator->free(_memory);
+	}
+
+	uint32_t TransientHeap::add(uint32_t firstPass, uint32_t lastPass)
+	{
+		Resource resource;
+		resource.firstPass = firstPass;
+		resource.lastPass = lastPass;
+		_resources.push_back(resource);
+		return static_cast<uint32_t>(_resources.size() - 1);
+	}
+
+	void TransientHeap::setPasses(uint32_t id, uint32_t firstPass, uint32_t lastPass)
+	{
+		Resource& resource = _resources[id];
+		if (resource.firstPass != firstPass || resource.lastPass != lastPass)
+		{
+			resource.firstPass = firstPass;
+			resource.lastPass = lastPass;
+			_dirty = true;
+		}
+	}
+
+	void TransientHeap::beginFrame()
+	{
+		if (!_dirty)
+		{
+			return;
+		}
+		_dirty = false;
+		plan();
+
+		if (_memory.memory == VK_NULL_HANDLE || _memory.size < _size || _memory.size / 4 > _size)
+		{
+			VkDeviceSize alignment = 1;
+			for (auto& resource : _resources)
+			{
+				alignment = (std::max)(alignment, resource.alignment);
+			}
+			VkMemoryRequirements memReqs = {};
+			memReqs.size = _size;
+			memReqs.alignment = alignment;
+			memReqs.memoryTypeBits = _memoryTypeBits;
+
+			// buffers still bound to the old range are rebound before their next
+			// use, frames in flight may still read it
+			_device->retireBuffer(VK_NULL_HANDLE, _memory);
+			_memory = MemoryAllocation();
+			uint32_t memoryType = _device->getMemoryType(_memoryTypeBits, _memoryPropertyFlags);
+			VK_CHECK_RESULT(_device->allocator->allocate(memReqs, memoryType, &_memory));
+		}
+		++_generation;
+	}
+
+	bool TransientHeap::bind(uint32_t id, VkBuffer buffer, const VkMemoryRequirements& memReqs)
+	{
+		Resource& resource = _resources[id];
+		if (_memory.memory == VK_NULL_HANDLE
+			|| memReqs.size > resource.size
+			|| memReqs.alignment > resource.alignment
+			|| (memReqs.memoryTypeBits & (1u << _memory.memoryType)) == 0)
+		{
+			resource.size = (std::max)(resource.size, memReqs.size);
+			resource.alignment = (std::max)(resource.alignment, memReqs.alignment);
+			_memoryTypeBits &= memReqs.memoryTypeBits;
+			_dirty = true;
+			return false;
+		}
+		VK_CHECK_RESULT(vkBindBufferMemory(_device->logicalDevice, buffer, _memory.memory, _memory.offset + resource.offset));
+		if (memReqs.size < resource.size)
+		{
+			// the buffer shrank, plan it smaller from the next frame on
+			resource.size = memReqs.size;
+			_dirty = true;
+		}
+		return true;
+	}
+
+	VkDeviceSize TransientHeap::unaliasedSize() const
+	{
+		VkDeviceSize size = 0;
+		for (auto& resource : _resources)
+		{
+			size += resource.size;
+		}
+		return size;
+	}
+
+	/**
+	* Largest first, each resource goes to the lowest offset that is clear
+	* of the already placed resources whose pass ranges overlap its own
+	*/
+	void TransientHeap::plan()
+	{
+		std::vector<uint32_t> order(_resources.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return _resources[a].size > _resources[b].size;
+		});
+
+		_size = 0;
+		std::vector<const Resource*> conflicts;
+		for (uint32_t k = 0; k < order.size(); ++k)
+		{
+			Resource& resource = _resources[order[k]];
+			conflicts.clear();
+			for (uint32_t j = 0; j < k; ++j)
+			{
+				const Resource& placed = _resources[order[j]];
+				if (placed.firstPass <= resource.lastPass && resource.firstPass <= placed.lastPass)
+				{
+					conflicts.push_back(&placed);
+				}
+			}
+			std::sort(conflicts.begin(), conflicts.end(), [](const Resource* a, const Resource* b) {
+				return a->offset < b->offset;
+			});
+
+			VkDeviceSize offset = 0;
+			for (const Resource* placed : conflicts)
+			{
+				if (offset + resource.size <= placed->offset)
+				{
+					break;
+				}
+				VkDeviceSize end = placed->offset + placed->size;
+				if (end > offset)
+				{
+					offset = (end + resource.alignment - 1) / resource.alignment * resource.alignment;
+				}
+			}
+			resource.offset = offset;
+			_size = (std::max)(_size, offset + resource.size);
+		}
+	}
+
+}// end of namespace vk
+}// end of namespace Galaxysailing
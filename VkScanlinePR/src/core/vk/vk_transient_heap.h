@@ -0,0 +1,82 @@
+#pragma once
+#ifndef GALAXYSAILING_VK_TRANSIENT_HEAP_H_
+#define GALAXYSAILING_VK_TRANSIENT_HEAP_H_
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "vk_device.h"
+
+namespace Galaxysailing {
+namespace vk {
+
+	/**
+	* @brief Device memory shared by buffers that are only alive during part of a frame
+	*
+	* Each resource is declared with the first and last pass of the frame
+	* that use it. Resources whose pass ranges don't overlap are placed at
+	* overlapping offsets of one memory range. The plan is only rebuilt in
+	* beginFrame(), a buffer asking for more than it was planned for gets
+	* memory of its own for the rest of the frame and is planned for at the
+	* next beginFrame().
+	*/
+	class TransientHeap
+	{
+	public:
+		TransientHeap(VulkanDevice* device, VkMemoryPropertyFlags memoryPropertyFlags);
+		~TransientHeap();
+
+		TransientHeap(const TransientHeap&) = delete;
+		TransientHeap& operator=(const TransientHeap&) = delete;
+
+		/** @brief Declare a resource used from pass 'firstPass' to 'lastPass', returns its id */
+		uint32_t add(uint32_t firstPass, uint32_t lastPass);
+
+		/** @brief Move the passes of resource 'id', the plan follows at the next beginFrame() */
+		void setPasses(uint32_t id, uint32_t firstPass, uint32_t lastPass);
+
+		/**
+		* @brief Re-plan with the sizes asked for since the last call
+		*
+		* @note The previous frame must be done with the heap, buffers rebind once generation() changed
+		*/
+		void beginFrame();
+
+		/** @brief Bind 'buffer' at the place planned for 'id', false when the plan has no room for it yet */
+		bool bind(uint32_t id, VkBuffer buffer, const VkMemoryRequirements& memReqs);
+
+		uint32_t generation() const { return _generation; }
+
+		/** @brief Bytes the current plan needs */
+		VkDeviceSize size() const { return _size; }
+
+		/** @brief Bytes the planned resources would need without aliasing */
+		VkDeviceSize unaliasedSize() const;
+
+	private:
+		struct Resource
+		{
+			uint32_t firstPass;
+			uint32_t lastPass;
+			VkDeviceSize size = 0;
+			VkDeviceSize alignment = 1;
+			VkDeviceSize offset = 0;
+		};
+
+		void plan();
+
+		VulkanDevice* _device;
+		VkMemoryPropertyFlags _memoryPropertyFlags;
+		std::vector<Resource> _resources;
+		MemoryAllocation _memory;
+		uint32_t _memoryTypeBits = ~0u;
+		VkDeviceSize _size = 0;
+		uint32_t _generation = 0;
+		bool _dirty = false;
+	};
+
+}// end of namespace vk
+}// end of namespace Galaxysailing
+
+#endif
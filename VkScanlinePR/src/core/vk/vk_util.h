@@ -3,7 +3,6 @@
 #define GALAXYSAILING_VK_UTIL_H_
 
 #include <vulkan/vulkan.h>
-#include <shaderc/shaderc.hpp>
 
 #include <string>
 #include <cstring>
@@ -44,25 +43,6 @@ namespace vk{
         VkShaderModule loadShader(const char* fileName, VkDevice device);
 
         std::string read_file(const std::string filename);
-
-        // Returns GLSL shader source text after preprocessing.
-        std::string preprocess_shader(const std::string& source_name,
-            shaderc_shader_kind kind,
-            const std::string& source);
-
-        // Compiles a shader to SPIR-V assembly. Returns the assembly text
-        // as a string.
-        std::string compile_file_to_assembly(const std::string& source_name,
-            shaderc_shader_kind kind,
-            const std::string& source,
-            bool optimize);
-
-        // Compiles a shader to a SPIR-V binary. Returns the binary as
-        // a vector of 32-bit words.
-        std::vector<uint32_t> compile_file(const std::string& source_name,
-            shaderc_shader_kind kind,
-            const std::string& source,
-            bool optimize);
     }
 
 }// end of namespace vk
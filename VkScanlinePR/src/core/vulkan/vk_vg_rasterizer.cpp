@@ -8,10 +8,24 @@
 #include <array>
 #include <iostream>
 #include <assert.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
 
 #include <GLFW/glfw3.h>
 
 namespace Galaxysailing {
+VulkanVGRasterizerBase::~VulkanVGRasterizerBase()
+{
+	if (_pipelineCache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	vkDeviceWaitIdle(_device);
+	savePipelineCache();
+	vkDestroyPipelineCache(_device, _pipelineCache, nullptr);
+}
+
 // ----------------------------- private inner function ----------------------------
 void VulkanVGRasterizerBase::initVulkan()
 {
@@ -72,14 +86,7 @@ void VulkanVGRasterizerBase::initVulkan()
 
 	_swapChain.connect(_instance, _physicalDevice, _device);
 
-	// Create synchronization objects
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vk::initializer::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queue
-	VK_CHECK_RESULT(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been submitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_semaphores.renderComplete));
+	// Synchronization semaphores are created per frame in flight in createSynchronizationPrimitives
 
 	// Set up submit info structure
 	// Semaphores will stay the same during application lifetime
@@ -269,6 +276,13 @@ void VulkanVGRasterizerBase::createCommandBuffers()
 			static_cast<uint32_t>(_drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(_device, &cmdBufAllocateInfo, _drawCmdBuffers.data()));
+
+	// One more per frame in flight, recorded every frame
+	_frames.resize(settings.framesInFlight);
+	cmdBufAllocateInfo.commandBufferCount = 1;
+	for (auto& frame : _frames) {
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(_device, &cmdBufAllocateInfo, &frame.cmdBuffer));
+	}
 }
 
 void VulkanVGRasterizerBase::createSynchronizationPrimitives()
@@ -279,6 +293,17 @@ void VulkanVGRasterizerBase::createSynchronizationPrimitives()
 	for (auto& fence : _waitFences) {
 		VK_CHECK_RESULT(vkCreateFence(_device, &fenceCreateInfo, nullptr, &fence));
 	}
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vk::initializer::semaphoreCreateInfo();
+	for (auto& frame : _frames) {
+		// Ensures that the image is displayed before we start submitting new commands to the queue
+		VK_CHECK_RESULT(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+		// Ensures that the image is not presented until all commands have been submitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+		VK_CHECK_RESULT(vkCreateFence(_device, &fenceCreateInfo, nullptr, &frame.fence));
+	}
+	_semaphores.presentComplete = _frames[0].presentComplete;
+	_semaphores.renderComplete = _frames[0].renderComplete;
 }
 
 void VulkanVGRasterizerBase::setupRenderPass()
@@ -364,13 +389,111 @@ void VulkanVGRasterizerBase::setupRenderPass()
 	VK_CHECK_RESULT(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_renderPass));
 }
 
+namespace {
+	// Prefix of the pipeline cache file, the driver's cache data follows
+	struct PipelineCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t driverVersion;
+		float coldMs;
+		uint32_t dataSize;
+	};
+	const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x50435653; // "SVCP"
+	// headerSize, headerVersion, vendorID, deviceID, then pipelineCacheUUID
+	const size_t PIPELINE_CACHE_HEADER_SIZE = sizeof(uint32_t) * 4 + VK_UUID_SIZE;
+}
+
+/**
+* Seeds the pipeline cache from the file of this device and driver, named by
+* the pipeline cache UUID and driver version. Data the driver would not
+* accept, judged by its header, is dropped and the cache starts empty.
+*/
 void VulkanVGRasterizerBase::createPipelineCache()
 {
+	char name[2 * VK_UUID_SIZE + 1];
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+	{
+		snprintf(name + 2 * i, 3, "%02x", _deviceProperties.pipelineCacheUUID[i]);
+	}
+	char driver[9];
+	snprintf(driver, sizeof(driver), "%08x", _deviceProperties.driverVersion);
+	_pipelineCacheFile.path = std::string("pipeline_cache_") + name + "_" + driver + ".bin";
+	_pipelineCacheFile.warm = false;
+
+	std::vector<char> data;
+	std::ifstream is(_pipelineCacheFile.path, std::ios::binary);
+	PipelineCacheFileHeader fileHeader = {};
+	if (is.is_open() && is.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader))
+		&& fileHeader.magic == PIPELINE_CACHE_FILE_MAGIC
+		&& fileHeader.driverVersion == _deviceProperties.driverVersion
+		&& fileHeader.dataSize >= PIPELINE_CACHE_HEADER_SIZE)
+	{
+		data.resize(fileHeader.dataSize);
+		if (!is.read(data.data(), data.size()))
+		{
+			data.clear();
+		}
+	}
+	if (!data.empty())
+	{
+		uint32_t header[4];
+		memcpy(header, data.data(), sizeof(header));
+		const uint8_t* uuid = reinterpret_cast<const uint8_t*>(data.data()) + sizeof(header);
+		bool valid = header[0] >= PIPELINE_CACHE_HEADER_SIZE && header[0] <= data.size()
+			&& header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header[2] == _deviceProperties.vendorID
+			&& header[3] == _deviceProperties.deviceID
+			&& memcmp(uuid, _deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+		if (!valid)
+		{
+			printf("pipeline cache: %s does not match the device, starting empty\n", _pipelineCacheFile.path.c_str());
+			data.clear();
+		}
+	}
+	_pipelineCacheFile.warm = !data.empty();
+	_pipelineCacheFile.coldMs = _pipelineCacheFile.warm ? fileHeader.coldMs : 0.0f;
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = data.size();
+	pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
 	VK_CHECK_RESULT(vkCreatePipelineCache(_device, &pipelineCacheCreateInfo, nullptr, &_pipelineCache));
 }
 
+void VulkanVGRasterizerBase::savePipelineCache()
+{
+	size_t size = 0;
+	VK_CHECK_RESULT(vkGetPipelineCacheData(_device, _pipelineCache, &size, nullptr));
+	std::vector<char> data(size);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(_device, _pipelineCache, &size, data.data()));
+
+	std::ofstream os(_pipelineCacheFile.path, std::ios::binary | std::ios::trunc);
+	if (!os.is_open())
+	{
+		printf("pipeline cache: could not write %s\n", _pipelineCacheFile.path.c_str());
+		return;
+	}
+	PipelineCacheFileHeader fileHeader = {};
+	fileHeader.magic = PIPELINE_CACHE_FILE_MAGIC;
+	fileHeader.driverVersion = _deviceProperties.driverVersion;
+	fileHeader.coldMs = _pipelineCacheFile.coldMs;
+	fileHeader.dataSize = static_cast<uint32_t>(size);
+	os.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+	os.write(data.data(), size);
+}
+
+void VulkanVGRasterizerBase::pipelinesBuilt(double ms)
+{
+	if (!_pipelineCacheFile.warm)
+	{
+		_pipelineCacheFile.coldMs = static_cast<float>(ms);
+		printf("pipelines built in %.1f ms, cold pipeline cache\n", ms);
+		return;
+	}
+	printf("pipelines built in %.1f ms from the pipeline cache, %.1f ms saved\n"
+		, ms, _pipelineCacheFile.coldMs - ms);
+}
+
 void VulkanVGRasterizerBase::setupFrameBuffer()
 {
 	// Create frame buffers for every swap chain image
@@ -417,6 +540,23 @@ void VulkanVGRasterizerBase::windowResize()
 }
 
 // ----------------------------- vulkan rasterization helper -----------------------------
+void VulkanVGRasterizerBase::beginFrame()
+{
+	FrameResources& frame = _frames[_frameIndex];
+	VK_CHECK_RESULT(vkWaitForFences(_device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+	// What this frame slot retired the last time around is free now
+	_vulkanDevice->beginFrameSlot(_frameIndex, static_cast<uint32_t>(_frames.size()));
+	_semaphores.presentComplete = frame.presentComplete;
+	_semaphores.renderComplete = frame.renderComplete;
+}
+
+VkFence VulkanVGRasterizerBase::frameFence()
+{
+	VkFence fence = _frames[_frameIndex].fence;
+	VK_CHECK_RESULT(vkResetFences(_device, 1, &fence));
+	return fence;
+}
+
 void VulkanVGRasterizerBase::prepareFrame()
 {
 	// Acquire the next image from the swap chain
@@ -432,6 +572,8 @@ void VulkanVGRasterizerBase::prepareFrame()
 void VulkanVGRasterizerBase::submitFrame()
 {
 	VkResult result = _swapChain.queuePresent(_presentQueue, _currentBuffer, _semaphores.renderComplete);
+	// No wait for the queue, the next frame records while this one runs
+	_frameIndex = (_frameIndex + 1) % static_cast<uint32_t>(_frames.size());
 		if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			// Swap chain is no longer compatible with the surface and needs to be recreated
@@ -442,7 +584,6 @@ void VulkanVGRasterizerBase::submitFrame()
 			VK_CHECK_RESULT(result);
 		}
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(_presentQueue));
 }
 VkPipelineShaderStageCreateInfo VulkanVGRasterizerBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
 {
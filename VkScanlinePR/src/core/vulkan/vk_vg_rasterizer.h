@@ -15,6 +15,10 @@
 namespace Galaxysailing {
 
 class VulkanVGRasterizerBase{
+public:
+	// Writes the pipeline cache back to disk
+	virtual ~VulkanVGRasterizerBase();
+
 // ----------------------------- vulkan function -----------------------------
 protected:
     void initVulkan();
@@ -35,6 +39,7 @@ private:
     void createSynchronizationPrimitives();
     void setupRenderPass();
     void createPipelineCache();
+    void savePipelineCache();
     void setupFrameBuffer();
 
 	void windowResize();
@@ -51,6 +56,8 @@ protected:
         bool vsync = false;
 		// Enable UI overlay
 		bool overlay = true;
+		// Frames the CPU records ahead of the GPU
+		uint32_t framesInFlight = 2;
     } settings;
 
     uint32_t _width, _height;
@@ -104,7 +111,15 @@ protected:
 	// List of shader modules created (stored for cleanup)
 	std::vector<VkShaderModule> shaderModules;
 	// Pipeline cache object
-	VkPipelineCache _pipelineCache;
+	VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+	// Pipeline cache file of the device and driver, see createPipelineCache
+	struct {
+		std::string path;
+		// Initial data passed the header checks
+		bool warm = false;
+		// Time the pipelines took to build without cached data
+		float coldMs = 0.0f;
+	} _pipelineCacheFile;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	vk::VulkanSwapChain _swapChain;
 
@@ -118,15 +133,36 @@ protected:
 
 	std::vector<VkFence> _waitFences;
 
+	// Command buffer, semaphores and fence of each frame in flight
+	struct FrameResources {
+		VkCommandBuffer cmdBuffer;
+		VkSemaphore presentComplete;
+		VkSemaphore renderComplete;
+		// Signaled by the frame's graphics submit
+		VkFence fence;
+	};
+	std::vector<FrameResources> _frames;
+	// Frame in flight being recorded, indexes _frames
+	uint32_t _frameIndex = 0;
+
 	std::shared_ptr<vk::VulkanDevice> _vulkanDevice;
 
 // ----------------------------- vulkan rasterization helper -------------------
 protected:
 
+	// Waits until the GPU is done with the frame that last used _frameIndex
+	void beginFrame();
+
 	void prepareFrame();
 
+	// Fence for the frame's last submit, unsignaled from here on
+	VkFence frameFence();
+
 	void submitFrame();
 
+	// Reports the time the derived class took to build its pipelines against the cold start
+	void pipelinesBuilt(double ms);
+
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
 };
 };
@@ -6,8 +6,10 @@
 
 #include <memory>
 #include <vector>
+#include <algorithm>
 
 #include "../vk/vk_device.h"
+#include "../vk/vk_transient_heap.h"
 #include "../vk/vk_initializer.h"
 
 #define VULKAN_BUFFER_PTR(T) std::shared_ptr<vulkan::VulkanBuffer<T>>
@@ -15,39 +17,300 @@
 namespace Galaxysailing {
 namespace vulkan {
 
+	// how resizeWithoutCopy() picks a new capacity
+	struct BufferPolicy {
+		// a growing buffer gets at least 'growth' times its old capacity
+		double growth = 2.0;
+		// room on top of the requested size when growing
+		double headroom = 0.0;
+		// round capacities up to a power of two
+		bool pow2 = true;
+		// shrink after this many resizes in a row asked for less than
+		// 'shrink_fraction' of the capacity, 0 never shrinks
+		uint32_t shrink_after = 0;
+		double shrink_fraction = 0.25;
+	};
+
+	// sizes are in bytes
+	struct BufferStats {
+		VkDeviceSize size = 0;
+		VkDeviceSize capacity = 0;
+		// largest size ever asked for
+		VkDeviceSize high_water = 0;
+		uint32_t grows = 0;
+		uint32_t shrinks = 0;
+	};
+
+	/*
+	* Command buffers, fences and staging memory behind the ReadbackFutures
+	* of one VulkanBuffer, all made on first use and then recycled. A
+	* finished future hands its command buffer and fence back, and the
+	* persistently mapped staging arena is rewound once no future points
+	* into it. A read that does not fit while older futures still hold the
+	* arena gets a bigger one, the old arena goes with its last future.
+	*/
+	class ReadbackPool {
+	public:
+		struct Arena {
+			std::shared_ptr<vk::VulkanDevice> device;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			vk::MemoryAllocation memory;
+			VkDeviceSize capacity = 0;
+			VkDeviceSize head = 0;
+
+			~Arena() {
+				device->destroyBuffer(buffer, memory);
+			}
+		};
+
+		struct Slot {
+			VkCommandBuffer cmd = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::shared_ptr<Arena> arena;
+			VkDeviceSize offset = 0;
+		};
+
+		ReadbackPool(std::shared_ptr<vk::VulkanDevice> device, VkQueue queue, uint32_t queue_family) {
+			_device = device;
+			_queue = queue;
+			// the command buffers must come from a pool of the family 'queue' belongs to
+			_pool = _device->createCommandPool(queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+		}
+
+		~ReadbackPool() {
+			// every future holds the pool, so all slots are back here
+			for (auto& slot : _free) {
+				vkDestroyFence(_device->logicalDevice, slot.fence, nullptr);
+			}
+			vkDestroyCommandPool(_device->logicalDevice, _pool, nullptr);
+		}
+
+		ReadbackPool(const ReadbackPool&) = delete;
+		ReadbackPool& operator=(const ReadbackPool&) = delete;
+
+		// submit the copy of 'size' bytes at 'offset' of 'src' to the staging arena,
+		// earlier submits on the queue that wrote 'src' are done before the copy
+		Slot submit(VkBuffer src, VkDeviceSize offset, VkDeviceSize size) {
+			Slot slot;
+			if (_free.empty()) {
+				slot.cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, _pool, false);
+				VkFenceCreateInfo fence_ci = vk::initializer::fenceCreateInfo(VK_FLAGS_NONE);
+				VK_CHECK_RESULT(vkCreateFence(_device->logicalDevice, &fence_ci, nullptr, &slot.fence));
+			}
+			else {
+				slot = _free.back();
+				_free.pop_back();
+				VK_CHECK_RESULT(vkResetFences(_device->logicalDevice, 1, &slot.fence));
+			}
+
+			VkDeviceSize range = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+			if (_arena && _arena.use_count() == 1) {
+				_arena->head = 0;
+			}
+			if (!_arena || _arena->head + range > _arena->capacity) {
+				VkDeviceSize capacity = _arena ? _arena->capacity * 2 : MIN_ARENA_SIZE;
+				_arena = std::make_shared<Arena>();
+				_arena->device = _device;
+				_arena->capacity = (std::max)(capacity, range);
+				VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT
+					, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+					, _arena->capacity, &_arena->buffer, &_arena->memory));
+			}
+			slot.arena = _arena;
+			slot.offset = _arena->head;
+			_arena->head += range;
+
+			VkCommandBufferBeginInfo begin_info = vk::initializer::commandBufferBeginInfo();
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.cmd, &begin_info));
+			VkMemoryBarrier barrier = vk::initializer::memoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+				, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			VkBufferCopy copy_region = {};
+			copy_region.srcOffset = offset;
+			copy_region.dstOffset = slot.offset;
+			copy_region.size = size;
+			vkCmdCopyBuffer(slot.cmd, src, slot.arena->buffer, 1, &copy_region);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(slot.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT
+				, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.cmd));
+
+			VkSubmitInfo submit_info = vk::initializer::submitInfo();
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &slot.cmd;
+			VK_CHECK_RESULT(vkQueueSubmit(_queue, 1, &submit_info, slot.fence));
+			return slot;
+		}
+
+		// 'slot' has signaled its fence
+		void release(Slot& slot) {
+			slot.arena.reset();
+			_free.push_back(slot);
+		}
+
+	private:
+		static const VkDeviceSize ARENA_ALIGNMENT = 16;
+		static const VkDeviceSize MIN_ARENA_SIZE = 4096;
+
+		std::shared_ptr<vk::VulkanDevice> _device;
+		VkQueue _queue;
+		VkCommandPool _pool = VK_NULL_HANDLE;
+		std::vector<Slot> _free;
+		std::shared_ptr<Arena> _arena;
+	};
+
+	/*
+	* Pending copy of a buffer range to host memory, made by
+	* VulkanBuffer::readAsync(). The copy is submitted on creation with a
+	* command buffer and fence from the buffer's ReadbackPool, ready() polls
+	* the fence and data()/get() wait for it. The command buffer, the fence
+	* and the staging range go back to the pool on destruction.
+	*/
+	template<class T>
+	class ReadbackFuture {
+	public:
+		ReadbackFuture(std::shared_ptr<ReadbackPool> pool, VkBuffer src, VkDeviceSize offset, uint32_t count) {
+			_pool = pool;
+			_count = count;
+			if (count == 0) {
+				return;
+			}
+			_slot = _pool->submit(src, offset, static_cast<VkDeviceSize>(sizeof(T)) * count);
+			_device = _slot.arena->device->logicalDevice;
+		}
+
+		~ReadbackFuture() {
+			if (_slot.fence == VK_NULL_HANDLE) {
+				return;
+			}
+			wait();
+			_pool->release(_slot);
+		}
+
+		ReadbackFuture(const ReadbackFuture&) = delete;
+		ReadbackFuture& operator=(const ReadbackFuture&) = delete;
+
+		bool ready() {
+			if (!_done && _slot.fence != VK_NULL_HANDLE) {
+				_done = vkGetFenceStatus(_device, _slot.fence) == VK_SUCCESS;
+			}
+			return _done || _slot.fence == VK_NULL_HANDLE;
+		}
+
+		void wait() {
+			if (!ready()) {
+				VK_CHECK_RESULT(vkWaitForFences(_device, 1, &_slot.fence, VK_TRUE, UINT64_MAX));
+				_done = true;
+			}
+		}
+
+		// valid while the future lives
+		const T* data() {
+			wait();
+			if (!_slot.arena) {
+				return nullptr;
+			}
+			return reinterpret_cast<const T*>(static_cast<const char*>(_slot.arena->memory.mapped) + _slot.offset);
+		}
+
+		uint32_t size() const {
+			return _count;
+		}
+
+		std::vector<T> get() {
+			const T* ptr = data();
+			return std::vector<T>(ptr, ptr + _count);
+		}
+
+	private:
+		std::shared_ptr<ReadbackPool> _pool;
+		VkDevice _device = VK_NULL_HANDLE;
+		uint32_t _count;
+		ReadbackPool::Slot _slot;
+		bool _done = false;
+	};
+
 	template<class T>
 	class VulkanBuffer {
 	public:
 		VulkanBuffer(std::shared_ptr<vk::VulkanDevice> device
 			, VkBufferUsageFlags usage_flags
 			, VkMemoryPropertyFlags memory_property_flags
-			, VkQueue queue) {
+			, VkQueue queue
+			, uint32_t queue_family) {
 			_device = device;
 			_usage_flags = usage_flags;
 			_memory_property_flags = memory_property_flags;
 			_queue = queue;
+			_queue_family = queue_family;
 		}
 
-		void resizeWithoutCopy(uint32_t len) {
-			VkDeviceSize new_size = static_cast<VkDeviceSize>(sizeof(T) * len);
-			if (new_size == _size) {
-				return;
-			}
+		~VulkanBuffer() {
+			destroy();
+		}
 
-			if (_capacity < new_size) {
-				destroy();
-				_capacity = tableSizeFor(new_size);
-				VK_CHECK_RESULT(_device->createBuffer(_usage_flags
-					, _memory_property_flags
-					, _capacity, &_buffer, &_memory));
+		VulkanBuffer(const VulkanBuffer&) = delete;
+		VulkanBuffer& operator=(const VulkanBuffer&) = delete;
+
+		void resizeWithoutCopy(VkDeviceSize len) {
+			VkDeviceSize new_size = static_cast<VkDeviceSize>(sizeof(T)) * len;
+			_stats.high_water = (std::max)(_stats.high_water, new_size);
+
+			// an empty buffer still gets a handle for its descriptor
+			if (!_buffer || _capacity < new_size) {
+				VkDeviceSize new_capacity = capacityFor(new_size);
+				if (_buffer) {
+					new_capacity = (std::max)(new_capacity, capacityFor(static_cast<VkDeviceSize>(_capacity * _policy.growth)));
+					++_stats.grows;
+				}
+				reallocate(new_capacity);
+			}
+			else if (_heap && _heap_generation != _heap->generation()) {
+				// the heap was re-planned, move to the new place
+				reallocate(_capacity);
+			}
+			else if (shouldShrink(new_size)) {
+				reallocate(capacityFor(_window_peak));
+				++_stats.shrinks;
+				resetWindow();
+			}
+			else if (new_size == _size) {
+				return;
 			}
 			_size = new_size;
 			setupBufInfo();
 		}
 
+		// share memory through 'heap' as its resource 'id', only the
+		// sizes given to resizeWithoutCopy() are kept across frames
+		void setTransient(std::shared_ptr<vk::TransientHeap> heap, uint32_t id) {
+			_heap = heap;
+			_heap_id = id;
+			if (_buffer) {
+				reallocate(_capacity);
+			}
+		}
+
+		void setPolicy(const BufferPolicy& policy) {
+			_policy = policy;
+			resetWindow();
+		}
+
+		BufferStats stats() const {
+			BufferStats res = _stats;
+			res.size = _size;
+			res.capacity = _capacity;
+			return res;
+		}
+
 		void set(T& data, uint32_t len) {
 			VkDeviceSize buf_size = static_cast<VkDeviceSize>(sizeof(T) * len);
-			if (_buffer && _memory) {
+			if (_buffer) {
 				if (_capacity < buf_size) {
 					throw std::runtime_error("Vulkan Buffer");
 				}
@@ -70,10 +333,33 @@ namespace vulkan {
 			setupBufInfo();
 		}
 
+		// set from plain memory, e.g. a section of a mapped scene file
+		void set(const T* data, uint32_t len) {
+			VkDeviceSize buf_size = static_cast<VkDeviceSize>(sizeof(T) * len);
+			if (_buffer) {
+				if (_capacity < buf_size) {
+					throw std::runtime_error("Vulkan Buffer::set(ptr) capacity too small.");
+				}
+				clear();
+				updateBuffer(data, buf_size);
+				_size = buf_size;
+			}
+			else {
+				destroy();
+				if ((_memory_property_flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0) {
+					createWithStagingCopy(data, buf_size);
+				}
+				else if ((_memory_property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+					createWithoutStagingCopy(data, buf_size);
+				}
+			}
+			setupBufInfo();
+		}
+
 		// set 
 		void set(std::vector<T>& data) {
 			VkDeviceSize buf_size = static_cast<VkDeviceSize>(sizeof(data[0]) * data.size());
-			if (_buffer && _memory) {
+			if (_buffer) {
 				if (_capacity < buf_size) {
 					throw std::runtime_error("Vulkan Buffer::set(vector) capacity too small.");
 				}
@@ -95,119 +381,88 @@ namespace vulkan {
 			setupBufInfo();
 		}
 
-		void clear() {
-			VkDevice device = _device->logicalDevice;
-			_host_data.ptr = nullptr;
-			if (_host_data.buf) {
-				vkDestroyBuffer(device, _host_data.buf, nullptr);
+		// overwrite elements [first, first + len) in place, the buffer keeps
+		// its handle so descriptor sets and recorded commands stay valid
+		void update(const T* data, uint32_t first, uint32_t len) {
+			VkDeviceSize offset = static_cast<VkDeviceSize>(sizeof(T)) * first;
+			VkDeviceSize buf_size = static_cast<VkDeviceSize>(sizeof(T)) * len;
+			if (!_buffer || offset + buf_size > _size) {
+				throw std::runtime_error("Vulkan Buffer::update out of range.");
 			}
-			if (_host_data.memory) {
-				//vkUnmapMemory(device, _host_data.memory);
-				vkFreeMemory(device, _host_data.memory, nullptr);
+			if (len == 0) {
+				return;
 			}
+			if (_memory.mapped) {
+				memcpy(static_cast<char*>(_memory.mapped) + offset, (const void*)data, (size_t)buf_size);
+				return;
+			}
+
+			VkBuffer staging_buf;
+			vk::MemoryAllocation staging_buf_mem;
+			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, buf_size, &staging_buf, &staging_buf_mem));
+			memcpy(staging_buf_mem.mapped, (const void*)data, (size_t)buf_size);
+
+			VkCommandBuffer copy_cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			VkBufferCopy copy_region = {};
+			copy_region.dstOffset = offset;
+			copy_region.size = buf_size;
+			vkCmdCopyBuffer(copy_cmd, staging_buf, _buffer, 1, &copy_region);
+			_device->flushCommandBuffer(copy_cmd, _queue, true);
+
+			_device->destroyBuffer(staging_buf, staging_buf_mem);
+		}
+
+		void clear() {
+			cptr_clear();
 		}
 
 		// release original memory
 		void destroy() {
-			VkDevice device = _device->logicalDevice;
-			if (_host_data.ptr) {
-				_host_data.ptr = nullptr;
-				if (_host_data.buf) {
-					vkDestroyBuffer(device, _host_data.buf, nullptr);
-				}
-				if (_host_data.memory) {
-					vkFreeMemory(device, _host_data.memory, nullptr);
-				}
-			}
+			cptr_clear();
 			if (_buffer) {
-				vkDestroyBuffer(device, _buffer, nullptr);
-			}
-			if (_memory) {
-				vkFreeMemory(device, _memory, nullptr);
+				_device->destroyBuffer(_buffer, _memory);
 			}
+			_buffer = VK_NULL_HANDLE;
+			_memory = vk::MemoryAllocation();
+			_size = 0;
+			_capacity = 0;
+			resetWindow();
 		}
 
 		// ---------------------- for debug -----------------------
 		T* cptr() {
-			if (_host_data.ptr == nullptr) {
-				VkCommandBuffer copy_cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-				VkBufferCopy copy_region = {};
-				copy_region.size = _size;
-				VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT
-					, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-					, _size, &_host_data.buf, &_host_data.memory));
-				vkCmdCopyBuffer(copy_cmd, _buffer, _host_data.buf, 1, &copy_region);
-				void* ppdata = (void*)_host_data.ptr;
-				vkMapMemory(_device->logicalDevice, _host_data.memory, 0, _size, 0, &ppdata);
-				_device->flushCommandBuffer(copy_cmd, _queue, true);
-				_host_data.ptr = (T*)ppdata;
+			if (!_host_data) {
+				_host_data = readAsync(0, static_cast<uint32_t>(_size / sizeof(T)));
 			}
-			return _host_data.ptr;
+			return const_cast<T*>(_host_data->data());
 		}
 		void cptr_clear() {
-			VkDevice device = _device->logicalDevice;
-			if (_host_data.ptr) {
-				_host_data.ptr = nullptr;
-				if (_host_data.buf) {
-					vkDestroyBuffer(device, _host_data.buf, nullptr);
-				}
-				if (_host_data.memory) {
-					vkFreeMemory(device, _host_data.memory, nullptr);
-				}
-			}
+			_host_data.reset();
 		}
 		// ----------------------------------------------------------
 
+		// waits for the copy, per frame reads go through ReadbackRing
 		T operator[](uint32_t index) {
-			VkCommandBuffer copy_cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			VkBufferCopy copy_region = {};
-			copy_region.size = static_cast<VkDeviceSize>(sizeof(T));
-			copy_region.srcOffset = static_cast<VkDeviceSize>(index * sizeof(T));
-
-			VkBuffer buf = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
-
-			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT
-				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-				, copy_region.size, &buf, &memory));
-			vkCmdCopyBuffer(copy_cmd, _buffer, buf, 1, &copy_region);
-			void* pdata;
-			vkMapMemory(_device->logicalDevice, memory, 0, copy_region.size, 0, &pdata);
-			_device->flushCommandBuffer(copy_cmd, _queue, true);
-			T res = *((T*)pdata);
-
-			// destroy
-			vkDestroyBuffer(_device->logicalDevice, buf, nullptr);
-			vkFreeMemory(_device->logicalDevice, memory, nullptr);
-			return res;
+			return readAsync(index, 1)->data()[0];
 		}
 
 		std::vector<T> get_list(uint32_t index, uint32_t size) {
-			VkCommandBuffer copy_cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			VkBufferCopy copy_region = {};
-			copy_region.size = static_cast<VkDeviceSize>(sizeof(T) * size);
-			copy_region.srcOffset = static_cast<VkDeviceSize>(index * sizeof(T));
-
-			VkBuffer buf = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
+			return readAsync(index, size)->get();
+		}
 
-			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT
-				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-				, copy_region.size, &buf, &memory));
-			vkCmdCopyBuffer(copy_cmd, _buffer, buf, 1, &copy_region);
-			void* pdata;
-			vkMapMemory(_device->logicalDevice, memory, 0, copy_region.size, 0, &pdata);
-			_device->flushCommandBuffer(copy_cmd, _queue, true);
-			std::vector<T> res;
-			res.reverse(size);
-			for (int i = 0; i < size; ++i) {
-				res.push_back(((T*)pdata)[i]);
+		// copy elements [first, first + count) to the host without waiting,
+		// the copy runs after the work submitted to the buffer's queue so far
+		std::shared_ptr<ReadbackFuture<T>> readAsync(uint32_t first, uint32_t count) {
+			VkDeviceSize offset = static_cast<VkDeviceSize>(sizeof(T)) * first;
+			if (offset + static_cast<VkDeviceSize>(sizeof(T)) * count > _size) {
+				throw std::runtime_error("Vulkan Buffer::readAsync out of range.");
 			}
-
-			// destroy
-			vkDestroyBuffer(_device->logicalDevice, buf, nullptr);
-			vkFreeMemory(_device->logicalDevice, memory, nullptr);
-			return res;
+			if (!_readback) {
+				_readback = std::make_shared<ReadbackPool>(_device, _queue, _queue_family);
+			}
+			return std::make_shared<ReadbackFuture<T>>(_readback, _buffer, offset, count);
 		}
 
 		VkBuffer buffer() {
@@ -236,57 +491,112 @@ namespace vulkan {
 
 	private:
 
-		int tableSizeFor(int cap) {
-			int n = cap - 1;
+		static VkDeviceSize tableSizeFor(VkDeviceSize cap) {
+			if (cap <= 1) {
+				return 1;
+			}
+			VkDeviceSize n = cap - 1;
 			n |= n >> 1;
 			n |= n >> 2;
 			n |= n >> 4;
 			n |= n >> 8;
 			n |= n >> 16;
-			return (n < 0) ? 1 : (n >= MAXIMUM_CAPACITY) ? MAXIMUM_CAPACITY : n + 1;
+			n |= n >> 32;
+			return n + 1;
+		}
+
+		VkDeviceSize capacityFor(VkDeviceSize size) const {
+			VkDeviceSize cap = (std::max)(size, static_cast<VkDeviceSize>(size * (1.0 + _policy.headroom)));
+			if (_policy.pow2) {
+				return tableSizeFor(cap);
+			}
+			return (std::max)(static_cast<VkDeviceSize>(CAPACITY_GRANULARITY)
+				, (cap + CAPACITY_GRANULARITY - 1) & ~(CAPACITY_GRANULARITY - 1));
+		}
+
+		void reallocate(VkDeviceSize capacity) {
+			// like destroy(), but frames in flight may still use the old buffer
+			cptr_clear();
+			if (_buffer) {
+				_device->retireBuffer(_buffer, _memory);
+			}
+			_buffer = VK_NULL_HANDLE;
+			_memory = vk::MemoryAllocation();
+			_size = 0;
+			resetWindow();
+			_capacity = capacity;
+			if (!_heap) {
+				VK_CHECK_RESULT(_device->createBuffer(_usage_flags
+					, _memory_property_flags
+					, _capacity, &_buffer, &_memory));
+				return;
+			}
+
+			VkBufferCreateInfo buffer_ci = vk::initializer::bufferCreateInfo(_usage_flags, _capacity);
+			buffer_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateBuffer(_device->logicalDevice, &buffer_ci, nullptr, &_buffer));
+			VkMemoryRequirements mem_reqs;
+			vkGetBufferMemoryRequirements(_device->logicalDevice, _buffer, &mem_reqs);
+			_heap_generation = _heap->generation();
+			if (_heap->bind(_heap_id, _buffer, mem_reqs)) {
+				return;
+			}
+			// not planned for yet, memory of its own until the next heap frame
+			uint32_t memory_type = _device->getMemoryType(mem_reqs.memoryTypeBits, _memory_property_flags);
+			VK_CHECK_RESULT(_device->allocator->allocate(mem_reqs, memory_type, &_memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(_device->logicalDevice, _buffer, _memory.memory, _memory.offset));
+		}
+
+		// 'size' fits, decide whether the capacity has been too large for long enough
+		bool shouldShrink(VkDeviceSize size) {
+			if (_policy.shrink_after == 0) {
+				return false;
+			}
+			if (size >= _capacity * _policy.shrink_fraction) {
+				resetWindow();
+				return false;
+			}
+			_window_peak = (std::max)(_window_peak, size);
+			if (++_window_uses < _policy.shrink_after) {
+				return false;
+			}
+			return capacityFor(_window_peak) < _capacity;
 		}
 
-		void updateBuffer(T* data, VkDeviceSize buf_size) {
-			VkDevice device = _device->logicalDevice;
-			if ((_memory_property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
-				void* cptr;
-				vkMapMemory(device, _memory, 0, buf_size, 0, &cptr);
-				memcpy(cptr, (void*)data, buf_size);
-				vkUnmapMemory(device, _memory);
+		void resetWindow() {
+			_window_peak = 0;
+			_window_uses = 0;
+		}
+
+		void updateBuffer(const T* data, VkDeviceSize buf_size) {
+			if (_memory.mapped) {
+				memcpy(_memory.mapped, (const void*)data, buf_size);
 			}
 		}
 
-		void createWithoutStagingCopy(T* data, VkDeviceSize buf_size) {
-			VkDevice device = _device->logicalDevice;
+		void createWithoutStagingCopy(const T* data, VkDeviceSize buf_size) {
 			_size = buf_size;
-			_capacity = tableSizeFor(buf_size);
+			_capacity = capacityFor(buf_size);
+			_stats.high_water = (std::max)(_stats.high_water, buf_size);
 
 			VK_CHECK_RESULT(_device->createBuffer(_usage_flags
 				, _memory_property_flags
 				, _capacity, &_buffer, &_memory));
-
-			void* cptr = nullptr;
-			vkMapMemory(device, _memory, 0, _size, 0, &cptr);
-			memcpy(cptr, (void*)data, (size_t)_size);
-			vkUnmapMemory(device, _memory);
+			memcpy(_memory.mapped, (const void*)data, (size_t)_size);
 		}
 
-		void createWithStagingCopy(T* data, VkDeviceSize buf_size) {
-			VkDevice device = _device->logicalDevice;
+		void createWithStagingCopy(const T* data, VkDeviceSize buf_size) {
 			_size = buf_size;
-			_capacity = tableSizeFor(buf_size);
+			_capacity = capacityFor(buf_size);
+			_stats.high_water = (std::max)(_stats.high_water, buf_size);
 
 			VkBuffer staging_buf;
-			VkDeviceMemory staging_buf_mem;
+			vk::MemoryAllocation staging_buf_mem;
 
 			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT
 				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
 				, buf_size, &staging_buf, &staging_buf_mem));
-
-			void* cptr = nullptr;
-			vkMapMemory(device, staging_buf_mem, 0, buf_size, 0, &cptr);
-			memcpy(cptr, (void*)data, (size_t)buf_size);
-			vkUnmapMemory(device, staging_buf_mem);
+			memcpy(staging_buf_mem.mapped, (const void*)data, (size_t)buf_size);
 
 			VK_CHECK_RESULT(_device->createBuffer(_usage_flags
 				, _memory_property_flags
@@ -298,6 +608,8 @@ namespace vulkan {
 			copy_region.size = buf_size;
 			vkCmdCopyBuffer(copy_cmd, staging_buf, _buffer, 1, &copy_region);
 			_device->flushCommandBuffer(copy_cmd, _queue, true);
+
+			_device->destroyBuffer(staging_buf, staging_buf_mem);
 		}
 
 		void setupBufInfo() {
@@ -308,21 +620,31 @@ namespace vulkan {
 
 		VkBufferUsageFlags _usage_flags;
 		VkMemoryPropertyFlags _memory_property_flags;
-		struct {
-			T* ptr = nullptr;
-			VkBuffer buf = VK_NULL_HANDLE;
-			VkDeviceMemory memory = VK_NULL_HANDLE;
-		} _host_data;
+		std::shared_ptr<ReadbackFuture<T>> _host_data;
+		// made by the first readAsync()
+		std::shared_ptr<ReadbackPool> _readback;
 		std::shared_ptr<vk::VulkanDevice> _device;
 
 		VkBuffer _buffer = VK_NULL_HANDLE;
-		VkDeviceMemory _memory = VK_NULL_HANDLE;
+		// a range of _device->allocator, empty while placed in _heap
+		vk::MemoryAllocation _memory;
 		VkDeviceSize _size = 0;
 		VkDeviceSize _capacity = 0;
 		VkDeviceSize _alignment = 0;
 		VkQueue _queue;
+		uint32_t _queue_family;
+
+		std::shared_ptr<vk::TransientHeap> _heap;
+		uint32_t _heap_id = 0;
+		uint32_t _heap_generation = 0;
+
+		BufferPolicy _policy;
+		BufferStats _stats;
+		// peak size of the resizes counted towards a shrink
+		VkDeviceSize _window_peak = 0;
+		uint32_t _window_uses = 0;
 
-		static const int MAXIMUM_CAPACITY = 1 << 30;
+		static const VkDeviceSize CAPACITY_GRANULARITY = 256;
 	};
 }// end of namespace vulkan
 }// end of namespace Galaxysailing
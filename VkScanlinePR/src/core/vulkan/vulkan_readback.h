@@ -0,0 +1,105 @@
+#pragma once
+#ifndef GALAXYSAILING_VULKAN_READBACK_H_
+#define GALAXYSAILING_VULKAN_READBACK_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <cstring>
+
+#include "vulkan_buffer.h"
+
+namespace Galaxysailing {
+namespace vulkan {
+
+	/*
+	* Scalar reads from device local buffers without per read allocations.
+	*
+	* One persistently mapped host visible buffer is split into fixed size
+	* slots used round robin. cmdRead() records the copy of one element
+	* into the caller's command buffer, the submit carrying it signals
+	* fence(), and get() waits on that fence and reads the slot. A caller
+	* that already waits for the submit another way skips fence().
+	*/
+	class ReadbackRing {
+	public:
+		ReadbackRing(std::shared_ptr<vk::VulkanDevice> device, uint32_t n_slots) {
+			_device = device;
+			_n_slots = n_slots;
+			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, SLOT_SIZE * n_slots, &_buffer, &_memory));
+
+			VkFenceCreateInfo fence_ci = vk::initializer::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+			VK_CHECK_RESULT(vkCreateFence(_device->logicalDevice, &fence_ci, nullptr, &_fence));
+		}
+
+		~ReadbackRing() {
+			vkDestroyFence(_device->logicalDevice, _fence, nullptr);
+			_device->destroyBuffer(_buffer, _memory);
+		}
+
+		ReadbackRing(const ReadbackRing&) = delete;
+		ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+		// copy src[index] into the next slot once the commands before it in
+		// 'cmd' wrote it, returns the slot for get()
+		template<class T>
+		uint32_t cmdRead(VkCommandBuffer cmd, const VULKAN_BUFFER_PTR(T)& src, uint32_t index) {
+			static_assert(sizeof(T) <= SLOT_SIZE, "ReadbackRing slot too small");
+			uint32_t slot = _next;
+			_next = (_next + 1) % _n_slots;
+
+			VkMemoryBarrier barrier = vk::initializer::memoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
+				, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			VkBufferCopy copy_region = {};
+			copy_region.srcOffset = static_cast<VkDeviceSize>(sizeof(T)) * index;
+			copy_region.dstOffset = SLOT_SIZE * slot;
+			copy_region.size = sizeof(T);
+			vkCmdCopyBuffer(cmd, src->buffer(), _buffer, 1, &copy_region);
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT
+				, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			return slot;
+		}
+
+		// fence for the vkQueueSubmit carrying the recorded reads
+		VkFence fence() {
+			VK_CHECK_RESULT(vkResetFences(_device->logicalDevice, 1, &_fence));
+			_pending = true;
+			return _fence;
+		}
+
+		template<class T>
+		T get(uint32_t slot) {
+			if (_pending) {
+				VK_CHECK_RESULT(vkWaitForFences(_device->logicalDevice, 1, &_fence, VK_TRUE, UINT64_MAX));
+				_pending = false;
+			}
+			T res;
+			memcpy(&res, static_cast<const char*>(_memory.mapped) + SLOT_SIZE * slot, sizeof(T));
+			return res;
+		}
+
+	private:
+		static const uint32_t SLOT_SIZE = 16;
+
+		std::shared_ptr<vk::VulkanDevice> _device;
+		VkBuffer _buffer = VK_NULL_HANDLE;
+		vk::MemoryAllocation _memory;
+		VkFence _fence = VK_NULL_HANDLE;
+		bool _pending = false;
+
+		uint32_t _n_slots;
+		uint32_t _next = 0;
+	};
+}// end of namespace vulkan
+}// end of namespace Galaxysailing
+
+#endif
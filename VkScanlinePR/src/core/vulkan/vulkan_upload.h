@@ -0,0 +1,249 @@
+#pragma once
+#ifndef GALAXYSAILING_VULKAN_UPLOAD_H_
+#define GALAXYSAILING_VULKAN_UPLOAD_H_
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "vulkan_buffer.h"
+#include "../common/thread_pool.h"
+
+namespace Galaxysailing {
+namespace vulkan {
+
+	/*
+	* Batched upload into device local VulkanBuffers.
+	*
+	* add() only sizes the destination and remembers the source, the data
+	* must stay valid until submit(). submit() packs every section into one
+	* staging arena, records all copies into one command buffer and waits
+	* on one fence, then returns the arena to the device allocator.
+	*/
+	class UploadBatch {
+	public:
+		UploadBatch(std::shared_ptr<vk::VulkanDevice> device, VkQueue queue) {
+			_device = device;
+			_queue = queue;
+		}
+
+		UploadBatch(const UploadBatch&) = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+
+		template<class T>
+		void add(const VULKAN_BUFFER_PTR(T)& dst, const T* data, uint32_t len) {
+			dst->resizeWithoutCopy(len);
+
+			Section s;
+			s.dst = dst->buffer();
+			s.data = data;
+			s.size = static_cast<VkDeviceSize>(sizeof(T)) * len;
+			s.offset = _size;
+			_sections.push_back(s);
+			_size += (s.size + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		}
+
+		// bytes the staging arena will take
+		VkDeviceSize size() const {
+			return _size;
+		}
+
+		void submit() {
+			if (_size == 0) {
+				_sections.clear();
+				return;
+			}
+			VkBuffer staging_buf;
+			vk::MemoryAllocation staging_buf_mem;
+			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, _size, &staging_buf, &staging_buf_mem));
+
+			char* arena = static_cast<char*>(staging_buf_mem.mapped);
+			ThreadPool::shared().parallelFor(_sections.size(), [&](size_t i) {
+				const Section& s = _sections[i];
+				if (s.size > 0) {
+					memcpy(arena + s.offset, s.data, (size_t)s.size);
+				}
+			});
+
+			VkCommandBuffer copy_cmd = _device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			for (const Section& s : _sections) {
+				if (s.size == 0) {
+					continue;
+				}
+				VkBufferCopy copy_region = {};
+				copy_region.srcOffset = s.offset;
+				copy_region.size = s.size;
+				vkCmdCopyBuffer(copy_cmd, staging_buf, s.dst, 1, &copy_region);
+			}
+			_device->flushCommandBuffer(copy_cmd, _queue, true);
+
+			_device->destroyBuffer(staging_buf, staging_buf_mem);
+			_sections.clear();
+			_size = 0;
+		}
+
+	private:
+		struct Section {
+			VkBuffer dst;
+			const void* data;
+			VkDeviceSize size;
+			VkDeviceSize offset;
+		};
+
+		static const VkDeviceSize SECTION_ALIGNMENT = 16;
+
+		std::shared_ptr<vk::VulkanDevice> _device;
+		VkQueue _queue;
+
+		std::vector<Section> _sections;
+		VkDeviceSize _size = 0;
+	};
+
+	/*
+	* Frame indexed ring of persistently mapped, coherent memory for data
+	* that changes every frame.
+	*
+	* Each of 'n_frames' regions is bump allocated from its start after
+	* beginFrame(), the caller makes sure the GPU is done with the frame
+	* that last used a region. With F frames in flight that takes F + 1
+	* regions: edits for frame N + 1 are written once frame N has begun,
+	* i.e. after the wait for frame N - F, the last one that used the
+	* region N + 1 gets. push() places uniform data at an offset a
+	* descriptor can point at, stage() places an edit of a device local
+	* buffer whose copy cmdFlushCopies() records. Edits that do not fit
+	* the region get a staging buffer of their own, released with the
+	* region's next use.
+	*/
+	class UploadRing {
+	public:
+		UploadRing(std::shared_ptr<vk::VulkanDevice> device, VkDeviceSize frame_size, uint32_t n_frames) {
+			_device = device;
+			_alignment = (std::max)(static_cast<VkDeviceSize>(16)
+				, _device->properties.limits.minUniformBufferOffsetAlignment);
+			_frame_size = (frame_size + _alignment - 1) & ~(_alignment - 1);
+			_n_frames = n_frames;
+			_overflow.resize(n_frames);
+			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, _frame_size * n_frames, &_buffer, &_memory));
+		}
+
+		~UploadRing() {
+			for (auto& overflow : _overflow) {
+				for (auto& o : overflow) {
+					_device->destroyBuffer(o.first, o.second);
+				}
+			}
+			_device->destroyBuffer(_buffer, _memory);
+		}
+
+		UploadRing(const UploadRing&) = delete;
+		UploadRing& operator=(const UploadRing&) = delete;
+
+		void beginFrame() {
+			_frame = (_frame + 1) % _n_frames;
+			_used = 0;
+			_copies.clear();
+			for (auto& o : _overflow[_frame]) {
+				_device->destroyBuffer(o.first, o.second);
+			}
+			_overflow[_frame].clear();
+		}
+
+		template<class T>
+		VkDescriptorBufferInfo push(const T& data) {
+			VkDescriptorBufferInfo info;
+			if (!alloc(&data, sizeof(T), &info.offset)) {
+				throw std::runtime_error("UploadRing::push frame region full.");
+			}
+			info.buffer = _buffer;
+			info.range = sizeof(T);
+			return info;
+		}
+
+		template<class T>
+		void stage(const VULKAN_BUFFER_PTR(T)& dst, const T* data, uint32_t first, uint32_t len) {
+			VkBufferCopy copy_region = {};
+			copy_region.dstOffset = static_cast<VkDeviceSize>(sizeof(T)) * first;
+			copy_region.size = static_cast<VkDeviceSize>(sizeof(T)) * len;
+			if (len == 0) {
+				return;
+			}
+			if (alloc(data, copy_region.size, &copy_region.srcOffset)) {
+				_copies.push_back({ _buffer, dst->buffer(), copy_region });
+				return;
+			}
+			// too large for the region, same copy from a buffer of its own
+			VkBuffer src;
+			vk::MemoryAllocation src_memory;
+			VK_CHECK_RESULT(_device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+				, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+				, copy_region.size, &src, &src_memory));
+			memcpy(src_memory.mapped, data, (size_t)copy_region.size);
+			_overflow[_frame].push_back(std::make_pair(src, src_memory));
+			copy_region.srcOffset = 0;
+			_copies.push_back({ src, dst->buffer(), copy_region });
+		}
+
+		bool hasCopies() const {
+			return !_copies.empty();
+		}
+
+		// record the staged copies, made visible to the compute shaders after them
+		void cmdFlushCopies(VkCommandBuffer cmd) {
+			if (_copies.empty()) {
+				return;
+			}
+			for (auto& c : _copies) {
+				vkCmdCopyBuffer(cmd, c.src, c.dst, 1, &c.region);
+			}
+			_copies.clear();
+
+			VkMemoryBarrier barrier = vk::initializer::memoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+				, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+	private:
+		bool alloc(const void* data, VkDeviceSize size, VkDeviceSize* offset) {
+			VkDeviceSize aligned = (size + _alignment - 1) & ~(_alignment - 1);
+			if (_used + aligned > _frame_size) {
+				return false;
+			}
+			*offset = _frame_size * _frame + _used;
+			memcpy(static_cast<char*>(_memory.mapped) + *offset, data, (size_t)size);
+			_used += aligned;
+			return true;
+		}
+
+		struct Copy {
+			VkBuffer src;
+			VkBuffer dst;
+			VkBufferCopy region;
+		};
+
+		std::shared_ptr<vk::VulkanDevice> _device;
+		VkBuffer _buffer = VK_NULL_HANDLE;
+		vk::MemoryAllocation _memory;
+		VkDeviceSize _alignment;
+		VkDeviceSize _frame_size;
+		uint32_t _n_frames;
+
+		uint32_t _frame = 0;
+		VkDeviceSize _used = 0;
+		std::vector<Copy> _copies;
+		// staging buffers of the edits too large for each region
+		std::vector<std::vector<std::pair<VkBuffer, vk::MemoryAllocation>>> _overflow;
+	};
+}// end of namespace vulkan
+}// end of namespace Galaxysailing
+
+#endif
@@ -1,13 +1,71 @@
 #include "app/vg_app.h"
+#include "core/vg/rvg_bench.h"
+#include "core/vg/bvg.h"
 #include <memory>
 #include <iostream>
+#include <string>
+#include <cstdlib>
 #include "windows.h"
 
 std::shared_ptr<VGApplication> app;
 
-int main(void) {
+int main(int argc, char** argv) {
+	// VkScanlinePR --bench-load [dir]
+	if (argc > 1 && std::string(argv[1]) == "--bench-load") {
+		Galaxysailing::benchmarkRVGLoad(argc > 2 ? argv[2] : "./input/rvg");
+		return 0;
+	}
+	// VkScanlinePR --convert input.rvg output.bvg
+	if (argc > 1 && std::string(argv[1]) == "--convert") {
+		if (argc < 4) {
+			std::cerr << "usage: " << argv[0] << " --convert input.rvg output.bvg\n";
+			return 1;
+		}
+		try {
+			Galaxysailing::BVG::convert(argv[2], argv[3]);
+		}
+		catch (std::exception& e) {
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+		return 0;
+	}
+
+	// VkScanlinePR [--simplify | --simplify-lossy [max_zoom]] [--autotune]
+	bool simplify = false;
+	bool simplify_lossy = false;
+	float max_zoom = 4.0f;
+	bool auto_tune = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--simplify") {
+			simplify = true;
+		}
+		else if (arg == "--simplify-lossy") {
+			simplify = true;
+			simplify_lossy = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				max_zoom = static_cast<float>(atof(argv[++i]));
+			}
+		}
+		else if (arg == "--autotune") {
+			auto_tune = true;
+		}
+		else {
+			std::cerr << "unknown argument \"" << arg << "\"\n"
+				<< "usage: " << argv[0] << " [--simplify | --simplify-lossy [max_zoom]] [--autotune]\n";
+			return 1;
+		}
+	}
+
 	app = getAppInstance();
 	try {
+		if (simplify) {
+			app->simplifyPaths(simplify_lossy, max_zoom);
+		}
+		if (auto_tune) {
+			app->autoTuneKernals();
+		}
 		app->appName("hello scanline vector graphic")
 			->viewport(0, 0, 1200, 1024)
 			->loadPathFile("./input/rvg/paper-1.rvg")
@@ -1,22 +1,32 @@
 import os
 # d = os.system('glslc compute/gen_fragment.comp -o compute/spv/gen_fragment.comp.spv')
 # print(__file__)
+
+# FNV-1a of the source, kept next to the binary to tell a stale one
+def source_hash(filename):
+    h = 14695981039346656037
+    with open(filename, 'rb') as f:
+        for c in f.read():
+            h = ((h ^ c) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return '%016x' % h
+
 def compile_shader(path):
     files = os.listdir(path)
     files = [elem for elem in files if elem.endswith('.comp') or elem.endswith('.vert') or elem.endswith('.frag')]
     for file in files:
-        filename = path + '\\' + file
-        out = path + '\\spv\\' + file + '.spv'
-        os.system('glslc ' + filename + ' -o ' + out)
+        filename = os.path.join(path, file)
+        out = os.path.join(path, 'spv', file + '.spv')
+        if os.system('glslc -O ' + filename + ' -o ' + out) == 0:
+            with open(out + '.hash', 'w') as f:
+                f.write(source_hash(filename) + '\n')
         # print('glslc ' + filename + ' -o ' + out)
 
 
 if __name__ == '__main__':
-    abs_path = __file__
-    abs_path = abs_path[0 : abs_path.rfind('\\')]
-    compute_dir = abs_path + '\\scanline\\compute'
-    surface_dir = abs_path + '\\scanline\\surface'
-    common_dir = abs_path + '\\common'
+    abs_path = os.path.dirname(os.path.abspath(__file__))
+    compute_dir = os.path.join(abs_path, 'scanline', 'compute')
+    surface_dir = os.path.join(abs_path, 'scanline', 'surface')
+    common_dir = os.path.join(abs_path, 'common')
     compile_shader(compute_dir)
     compile_shader(surface_dir)
-    compile_shader(common_dir)
\ No newline at end of file
+    compile_shader(common_dir)